@@ -21,6 +21,8 @@
 #ifndef _BMI_PORT_
 #define _BMI_PORT_
 
+#include <pthread.h>
+
 typedef struct bmi_port_s bmi_port_t;
 
 typedef struct bmi_port_mgr_s bmi_port_mgr_t;
@@ -36,6 +38,8 @@ int bmi_set_packet_handler(bmi_port_mgr_t *port_mgr,
 			   bmi_packet_handler_t packet_handler,
 			   void *cookie);
 
+int bmi_port_get_select_thread(bmi_port_mgr_t *port_mgr, pthread_t *thread);
+
 int bmi_port_send(bmi_port_mgr_t *port_mgr,
 		  int port_num, const char *buffer, int len);
 
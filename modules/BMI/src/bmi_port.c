@@ -124,6 +124,11 @@ int bmi_port_create_mgr(bmi_port_mgr_t **port_mgr) {
   return 0;
 }
 
+int bmi_port_get_select_thread(bmi_port_mgr_t *port_mgr, pthread_t *thread) {
+  *thread = port_mgr->select_thread;
+  return 0;
+}
+
 int bmi_set_packet_handler(bmi_port_mgr_t *port_mgr,
 			   bmi_packet_handler_t packet_handler,
 			   void *cookie) {
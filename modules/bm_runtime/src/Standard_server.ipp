@@ -100,6 +100,19 @@ public:
     }
   }
 
+  static void build_add_entry_results(
+      std::vector<BmAddEntryResult> &results,
+      const std::vector<MatchErrorCode> &rcs,
+      const std::vector<entry_handle_t> &handles) {
+    results.resize(rcs.size());
+    for(size_t i = 0; i < rcs.size(); i++) {
+      if(rcs[i] == MatchErrorCode::SUCCESS)
+	results[i].entry_handle = handles[i];
+      else
+	results[i].__set_error(get_exception_code(rcs[i]));
+    }
+  }
+
   BmEntryHandle bm_mt_add_entry(const std::string& table_name, const BmMatchParams& match_key, const std::string& action_name, const BmActionData& action_data, const BmAddEntryOptions& options) {
     printf("bm_table_add_entry\n");
     entry_handle_t entry_handle;
@@ -125,6 +138,32 @@ public:
     return entry_handle;
   }
 
+  void bm_mt_add_entries(std::vector<BmAddEntryResult> & _return, const std::string& table_name, const std::vector<BmNewEntry> & entries) {
+    printf("bm_mt_add_entries\n");
+    std::vector<RuntimeInterface::NewEntry> new_entries(entries.size());
+    for(size_t i = 0; i < entries.size(); i++) {
+      const BmNewEntry &entry = entries[i];
+      RuntimeInterface::NewEntry &new_entry = new_entries[i];
+      build_match_key(new_entry.match_key, entry.match_key);
+      new_entry.action_name = entry.action_name;
+      for(const std::string &d : entry.action_data) {
+	new_entry.action_data.push_back_action_data(d.data(), d.size());
+      }
+      new_entry.priority = entry.options.priority;
+    }
+    std::vector<MatchErrorCode> rcs;
+    std::vector<entry_handle_t> handles;
+    MatchErrorCode error_code = switch_->mt_add_entries(
+      table_name, std::move(new_entries), &rcs, &handles
+    );
+    if(error_code != MatchErrorCode::SUCCESS) {
+      InvalidTableOperation ito;
+      ito.what = get_exception_code(error_code);
+      throw ito;
+    }
+    build_add_entry_results(_return, rcs, handles);
+  }
+
   void bm_mt_set_default_action(const std::string& table_name, const std::string& action_name, const BmActionData& action_data) {
     printf("bm_set_default_action\n");
     ActionData data;
@@ -251,6 +290,27 @@ public:
     return entry_handle;
   }
 
+  void bm_mt_indirect_add_entries(std::vector<BmAddEntryResult> & _return, const std::string& table_name, const std::vector<BmIndirectNewEntry> & entries) {
+    printf("bm_mt_indirect_add_entries\n");
+    std::vector<RuntimeInterface::IndirectNewEntry> new_entries(entries.size());
+    for(size_t i = 0; i < entries.size(); i++) {
+      build_match_key(new_entries[i].match_key, entries[i].match_key);
+      new_entries[i].mbr = entries[i].mbr_handle;
+      new_entries[i].priority = entries[i].options.priority;
+    }
+    std::vector<MatchErrorCode> rcs;
+    std::vector<entry_handle_t> handles;
+    MatchErrorCode error_code = switch_->mt_indirect_add_entries(
+      table_name, new_entries, &rcs, &handles
+    );
+    if(error_code != MatchErrorCode::SUCCESS) {
+      InvalidTableOperation ito;
+      ito.what = get_exception_code(error_code);
+      throw ito;
+    }
+    build_add_entry_results(_return, rcs, handles);
+  }
+
   void bm_mt_indirect_modify_entry(const std::string& table_name, const BmEntryHandle entry_handle, const BmMemberHandle mbr_handle) {
     printf("bm_mt_indirect_modify_entry\n");
     MatchErrorCode error_code = switch_->mt_indirect_modify_entry(
@@ -366,6 +426,29 @@ public:
     return entry_handle;
   }
 
+  void bm_mt_indirect_ws_add_entries(std::vector<BmAddEntryResult> & _return, const std::string& table_name, const std::vector<BmIndirectWsNewEntry> & entries) {
+    printf("bm_mt_indirect_ws_add_entries\n");
+    std::vector<RuntimeInterface::IndirectWSNewEntry> new_entries(
+      entries.size()
+    );
+    for(size_t i = 0; i < entries.size(); i++) {
+      build_match_key(new_entries[i].match_key, entries[i].match_key);
+      new_entries[i].grp = entries[i].grp_handle;
+      new_entries[i].priority = entries[i].options.priority;
+    }
+    std::vector<MatchErrorCode> rcs;
+    std::vector<entry_handle_t> handles;
+    MatchErrorCode error_code = switch_->mt_indirect_ws_add_entries(
+      table_name, new_entries, &rcs, &handles
+    );
+    if(error_code != MatchErrorCode::SUCCESS) {
+      InvalidTableOperation ito;
+      ito.what = get_exception_code(error_code);
+      throw ito;
+    }
+    build_add_entry_results(_return, rcs, handles);
+  }
+
   void bm_mt_indirect_ws_modify_entry(const std::string& table_name, const BmEntryHandle entry_handle, const BmGroupHandle grp_handle) {
     printf("bm_mt_indirect_ws_modify_entry\n");
     MatchErrorCode error_code = switch_->mt_indirect_ws_modify_entry(
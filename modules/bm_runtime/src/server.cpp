@@ -32,6 +32,8 @@
 #include "SimplePre_server.ipp"
 #include "SimplePreLAG_server.ipp"
 
+#include "bm_sim/thread_affinity.h"
+
 using namespace ::apache::thrift;
 using namespace ::apache::thrift::protocol;
 using namespace ::apache::thrift::transport;
@@ -63,6 +65,9 @@ bool switch_has_component() {
 }
 
 int serve(int port) {
+  // the threads of the server inherit the affinity
+  ThreadAffinity::pin_current_thread(ThreadAffinity::Role::THRIFT);
+
   shared_ptr<TMultiplexedProcessor> processor(new TMultiplexedProcessor());
   processor_ = processor.get();
 
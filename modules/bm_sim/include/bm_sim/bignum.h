@@ -26,6 +26,8 @@
 
 #include <gmp.h>
 
+#include <cstdint>
+
 namespace bignum {
 
   using namespace boost::multiprecision;
@@ -42,6 +44,42 @@ namespace bignum {
     mpz_import(dst.backend().data(), 1, 1, size, 1, 0, src);
   }
 
+  // native integers used by Data for all values which fit in 128 bits (signed)
+  __extension__ typedef __int128 int128_t;
+  __extension__ typedef unsigned __int128 uint128_t;
+
+  // number of bits available for the magnitude of a native value
+  static const int native_bits = 127;
+
+  inline void from_native(Bignum &dst, int128_t src) {
+    uint128_t mag = (src < 0) ? -static_cast<uint128_t>(src) : src;
+    // least significant word first, native endianness
+    uint64_t words[2] = {static_cast<uint64_t>(mag),
+			 static_cast<uint64_t>(mag >> 64)};
+    mpz_import(dst.backend().data(), 2, -1, sizeof(uint64_t), 0, 0, words);
+    if(src < 0) mpz_neg(dst.backend().data(), dst.backend().data());
+  }
+
+  // returns false if src does not fit in a native integer
+  inline bool to_native(const Bignum &src, int128_t *dst) {
+    const mpz_t &z = src.backend().data();
+    if(mpz_sizeinbase(z, 2) > static_cast<size_t>(native_bits + 1))
+      return false;
+    uint64_t words[2] = {0, 0};
+    mpz_export(words, nullptr, -1, sizeof(uint64_t), 0, 0, z);
+    uint128_t mag = (static_cast<uint128_t>(words[1]) << 64) | words[0];
+    const uint128_t min_mag = static_cast<uint128_t>(1) << native_bits;
+    if(mpz_sgn(z) < 0) {
+      if(mag > min_mag) return false;
+      *dst = static_cast<int128_t>(-mag);
+    }
+    else {
+      if(mag >= min_mag) return false;
+      *dst = static_cast<int128_t>(mag);
+    }
+    return true;
+  }
+
 }
 
 #endif
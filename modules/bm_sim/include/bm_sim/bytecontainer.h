@@ -23,38 +23,48 @@
 
 #include <vector>
 #include <iterator>
+#include <algorithm>
 #include <string>
 #include <iostream>
 #include <sstream> 
 #include <iomanip>
 
+#include <cassert>
+
 #include <boost/functional/hash.hpp>
 
 using std::vector;
 
+/* Containers of up to inline_capacity bytes (which covers most fields and match
+   keys) are stored inline and do not require any heap allocation. */
+
 class ByteContainer
 {
 public:
-  typedef vector<char>::iterator iterator;
-  typedef vector<char>::const_iterator const_iterator;
+  typedef char *iterator;
+  typedef const char *const_iterator;
   // typedef std::reverse_iterator<iterator> reverse_iterator;
   // typedef std::reverse_iterator<const_iterator> const_reverse_iterator;
-  typedef vector<char>::reference reference;
-  typedef vector<char>::const_reference const_reference;
+  typedef char &reference;
+  typedef const char &const_reference;
   typedef size_t size_type;
 
+  static const size_type inline_capacity = 16;
+
 public:
-  ByteContainer()
-    : bytes() {}
+  ByteContainer() {}
 
-  ByteContainer(int nbytes)
-    : bytes(vector<char>(nbytes)) {}
+  ByteContainer(int nbytes) {
+    resize(nbytes);
+  }
 
-  ByteContainer(const vector<char> &bytes)
-    : bytes(bytes) {}
+  ByteContainer(const vector<char> &bytes) {
+    append(bytes.data(), bytes.size());
+  }
 
-  ByteContainer(const char *bytes, size_t nbytes)
-    : bytes(vector<char>(bytes, bytes + nbytes)) {}
+  ByteContainer(const char *bytes, size_t nbytes) {
+    append(bytes, nbytes);
+  }
 
   static char char2digit(char c) {
     if(c >= '0' && c <= '9')
@@ -67,8 +77,7 @@ public:
     return 0;
   }
 
-  ByteContainer(const std::string &hexstring)
-    : bytes() {
+  ByteContainer(const std::string &hexstring) {
     size_t idx = 0;
 
     assert(hexstring[idx] != '-');
@@ -81,28 +90,53 @@ public:
 
     if((size - idx) % 2 != 0) {
       char c = char2digit(hexstring[idx++]);
-      bytes.push_back(c);
+      push_back(c);
     }
 
     for(; idx < size; ) {
       char c = char2digit(hexstring[idx++]) << 4;
       c += char2digit(hexstring[idx++]);
-      bytes.push_back(c);
+      push_back(c);
     }
   }
 
-  size_type size() const noexcept { return bytes.size(); }
+  ByteContainer(const ByteContainer &other) {
+    append(other.data(), other.size());
+  }
 
-  void clear() { return bytes.clear(); }
+  ByteContainer(ByteContainer &&other) noexcept {
+    move_from(other);
+  }
+
+  ByteContainer &operator=(const ByteContainer &other) {
+    if(this == &other) return *this;
+    clear();
+    return append(other.data(), other.size());
+  }
+
+  ByteContainer &operator=(ByteContainer &&other) noexcept {
+    if(this == &other) return *this;
+    release();
+    move_from(other);
+    return *this;
+  }
+
+  ~ByteContainer() {
+    release();
+  }
+
+  size_type size() const noexcept { return size_; }
+
+  void clear() { size_ = 0; }
 
   // iterators
-  iterator begin() { return bytes.begin(); }
+  iterator begin() { return bytes; }
 
-  const_iterator begin() const { return bytes.begin(); }
+  const_iterator begin() const { return bytes; }
 
-  iterator end() { return bytes.end(); }
+  iterator end() { return bytes + size_; }
 
-  const_iterator end() const { return bytes.end(); }
+  const_iterator end() const { return bytes + size_; }
 
   // reverse_iterator rbegin() { return bytes.rbegin(); }
 
@@ -121,22 +155,34 @@ public:
   // const_reverse_iterator crend() const { return bytes.crend(); }
 
   ByteContainer &append(const ByteContainer &other) {
-    bytes.insert(end(), other.begin(), other.end());
-    return *this;
+    return append(other.data(), other.size());
   }
 
   ByteContainer &append(const char *byte_array, size_t nbytes) {
-    bytes.insert(end(), byte_array, byte_array + nbytes);
+    if(size_ + nbytes > capacity) {
+      // byte_array may point inside this container, so we cannot use reserve
+      size_type new_capacity = std::max(2 * capacity, size_ + nbytes);
+      char *new_bytes = new char[new_capacity];
+      std::copy(bytes, bytes + size_, new_bytes);
+      std::copy(byte_array, byte_array + nbytes, new_bytes + size_);
+      release();
+      bytes = new_bytes;
+      capacity = new_capacity;
+    }
+    else {
+      std::copy(byte_array, byte_array + nbytes, bytes + size_);
+    }
+    size_ += nbytes;
     return *this;
   }
 
   ByteContainer &append(const std::string &other) {
-    bytes.insert(end(), other.begin(), other.end());
-    return *this;
+    return append(other.data(), other.size());
   }
 
   void push_back(char c) {
-    bytes.push_back(c);
+    if(size_ == capacity) reserve(2 * capacity);
+    bytes[size_++] = c;
   }
 
   reference operator[](size_type n) {
@@ -150,15 +196,15 @@ public:
   }
 
   char* data() noexcept {
-    return bytes.data();
+    return bytes;
   }
 
   const char* data() const noexcept {
-    return bytes.data();
+    return bytes;
   }
 
   bool operator==(const ByteContainer& other) const {
-    return bytes == other.bytes;
+    return (size_ == other.size_) && std::equal(begin(), end(), other.begin());
   }
 
   bool operator!=(const ByteContainer& other) const {
@@ -166,11 +212,19 @@ public:
   }
 
   void reserve(size_t n) {
-    bytes.reserve(n);
+    if(n <= capacity) return;
+    char *new_bytes = new char[n];
+    std::copy(bytes, bytes + size_, new_bytes);
+    release();
+    bytes = new_bytes;
+    capacity = n;
   }
 
+  // new bytes are set to 0
   void resize(size_t n) {
-    bytes.resize(n);
+    reserve(n);
+    if(n > size_) std::fill(bytes + size_, bytes + n, 0);
+    size_ = n;
   }
 
   std::string to_hex(bool upper_case = false) const {
@@ -186,7 +240,34 @@ public:
   }
 
 private:
-  vector<char> bytes;
+  bool is_inline() const { return bytes == inline_bytes; }
+
+  void release() {
+    if(!is_inline()) delete[] bytes;
+    bytes = inline_bytes;
+    capacity = inline_capacity;
+  }
+
+  // expects this container to be empty and inline
+  void move_from(ByteContainer &other) {
+    if(other.is_inline()) {
+      std::copy(other.begin(), other.end(), inline_bytes);
+    }
+    else {
+      bytes = other.bytes;
+      capacity = other.capacity;
+      other.bytes = other.inline_bytes;
+      other.capacity = inline_capacity;
+    }
+    size_ = other.size_;
+    other.size_ = 0;
+  }
+
+private:
+  char *bytes{inline_bytes};
+  size_type size_{0};
+  size_type capacity{inline_capacity};
+  char inline_bytes[inline_capacity];
 };
 
 struct ByteContainerKeyHash {
@@ -31,18 +31,28 @@
 
 using bignum::Bignum;
 
+/* Values which fit in a signed 128-bit integer (which includes every field of
+   up to 64 bits, as well as the result of any arithmetic operation on such
+   fields) are stored natively. The GMP-backed Bignum is only used for the
+   values which do not fit, and we make sure that a value which fits is never
+   stored as a Bignum. */
+
 class Data
-{  
+{
+public:
+  typedef bignum::int128_t native_t;
+  typedef bignum::uint128_t unative_t;
+
 public:
   Data() {}
 
   template<typename T,
 	   typename std::enable_if<std::is_integral<T>::value, int>::type = 0>
   Data(T i)
-    : value(i) {}
+    : native(i) {}
 
   Data(const char *bytes, int nbytes) {
-    bignum::import_bytes(value, bytes, nbytes);
+    import_bytes(bytes, nbytes);
   }
   
   virtual ~Data() { };
@@ -68,29 +78,29 @@ public:
   template<typename T,
 	   typename std::enable_if<std::is_integral<T>::value, int>::type = 0>
   void set(T i) {
-    value = i;
+    set_native(i);
     export_bytes();
   }
 
   template<typename T,
 	   typename std::enable_if<std::is_enum<T>::value, int>::type = 0>
   void set(T i) {
-    value = (int) i;
+    set_native((int) i);
     export_bytes();
   }
   
   void set(const char *bytes, int nbytes) {
-    bignum::import_bytes(value, bytes, nbytes);
+    import_bytes(bytes, nbytes);
     export_bytes();
   }
 
   void set(const Data &data) {
-    value = data.value;
+    copy_value(data);
     export_bytes();
   }
 
   void set(const ByteContainer &bc) {
-    bignum::import_bytes(value, bc.data(), bc.size());
+    import_bytes(bc.data(), bc.size());
     export_bytes();
   }
 
@@ -120,8 +130,12 @@ public:
       bytes.push_back(c);
     }
 
-    bignum::import_bytes(value, bytes.data(), bytes.size());
-    if(neg) value = -value;
+    import_bytes(bytes.data(), bytes.size());
+    if(neg) {
+      // cannot overflow, an imported native value is always positive
+      if(is_native) native = -native;
+      else set_big(-value);
+    }
     export_bytes(); // not very efficient for fields, we import then export...
   }
 
@@ -129,24 +143,32 @@ public:
 	   typename std::enable_if<std::is_integral<T>::value, int>::type = 0>
   T get() const {
     assert(arith);
+    refresh_value();
+    if(is_native) return static_cast<T>(native);
     return static_cast<T>(value);
   }
 
   unsigned int get_uint() const {
     assert(arith);
     // Bad ?
+    refresh_value();
+    if(is_native) return static_cast<unsigned>(native);
     return (unsigned) value;
   }
 
   uint64_t get_uint64() const {
     assert(arith);
     // Bad ?
+    refresh_value();
+    if(is_native) return static_cast<uint64_t>(native);
     return (uint64_t) value;
   }
 
   int get_int() const {
     assert(arith);
     // Bad ?
+    refresh_value();
+    if(is_native) return static_cast<int>(native);
     return (int) value;
   }
 
@@ -156,75 +178,121 @@ public:
 
   void add(const Data &src1, const Data &src2) {
     assert(src1.arith && src2.arith);
-    value = src1.value + src2.value;
+    src1.refresh_value(); src2.refresh_value();
+    native_t res;
+    if(src1.is_native && src2.is_native &&
+       !__builtin_add_overflow(src1.native, src2.native, &res)) {
+      set_native(res);
+    }
+    else {
+      set_big(src1.get_big() + src2.get_big());
+    }
     export_bytes();
   }
 
   void sub(const Data &src1, const Data &src2) {
     assert(src1.arith && src2.arith);
-    value = src1.value - src2.value;
+    src1.refresh_value(); src2.refresh_value();
+    native_t res;
+    if(src1.is_native && src2.is_native &&
+       !__builtin_sub_overflow(src1.native, src2.native, &res)) {
+      set_native(res);
+    }
+    else {
+      set_big(src1.get_big() - src2.get_big());
+    }
     export_bytes();
   }
 
   void mod(const Data &src1, const Data &src2) {
     assert(src1.arith && src2.arith);
-    value = src1.value % src2.value;
+    src1.refresh_value(); src2.refresh_value();
+    // division by 0 handled by Bignum
+    if(src1.is_native && src2.is_native && src2.native != 0) {
+      // avoid overflow for min % -1
+      set_native((src2.native == -1) ? 0 : src1.native % src2.native);
+    }
+    else {
+      set_big(src1.get_big() % src2.get_big());
+    }
     export_bytes();
   }
 
   void shift_left(const Data &src1, const Data &src2) {
     assert(src1.arith && src2.arith);
-    assert(src2.value >= 0);
-    value = src1.value << (src2.get_uint());
+    src1.refresh_value();
+    assert(src2 >= Data(0));
+    shift_left_(src1, src2.get_uint());
     export_bytes();
   }
 
   void shift_right(const Data &src1, const Data &src2) {
     assert(src1.arith && src2.arith);
-    assert(src2.value >= 0);
-    value = src1.value >> (src2.get_uint());
+    src1.refresh_value();
+    assert(src2 >= Data(0));
+    shift_right_(src1, src2.get_uint());
     export_bytes();
   }
 
   void shift_left(const Data &src1, unsigned int src2) {
     assert(src1.arith);
-    value = src1.value << src2;
+    src1.refresh_value();
+    shift_left_(src1, src2);
     export_bytes();
   }
 
   void shift_right(const Data &src1, unsigned int src2) {
     assert(src1.arith);
-    value = src1.value >> src2;
+    src1.refresh_value();
+    shift_right_(src1, src2);
     export_bytes();
   }
 
+  // bitwise operations on 2 native values always produce a native value
+
   void bit_and(const Data &src1, const Data &src2) {
     assert(src1.arith && src2.arith);
-    value = src1.value & src2.value;
+    src1.refresh_value(); src2.refresh_value();
+    if(src1.is_native && src2.is_native)
+      set_native(src1.native & src2.native);
+    else
+      set_big(src1.get_big() & src2.get_big());
     export_bytes();
   }
 
   void bit_or(const Data &src1, const Data &src2) {
     assert(src1.arith && src2.arith);
-    value = src1.value | src2.value;
+    src1.refresh_value(); src2.refresh_value();
+    if(src1.is_native && src2.is_native)
+      set_native(src1.native | src2.native);
+    else
+      set_big(src1.get_big() | src2.get_big());
     export_bytes();
   }
 
   void bit_xor(const Data &src1, const Data &src2) {
     assert(src1.arith && src2.arith);
-    value = src1.value ^ src2.value;
+    src1.refresh_value(); src2.refresh_value();
+    if(src1.is_native && src2.is_native)
+      set_native(src1.native ^ src2.native);
+    else
+      set_big(src1.get_big() ^ src2.get_big());
     export_bytes();
   }
 
   void bit_neg(const Data &src) {
     assert(src.arith);
-    value = ~src.value;
+    src.refresh_value();
+    if(src.is_native)
+      set_native(~src.native);
+    else
+      set_big(~src.value);
     export_bytes();
   }
 
   friend bool operator==(const Data &lhs, const Data &rhs) {
     assert(lhs.arith && rhs.arith);
-    return lhs.value == rhs.value;
+    return compare(lhs, rhs) == 0;
   }
 
   friend bool operator!=(const Data &lhs, const Data &rhs) {
@@ -234,27 +302,28 @@ public:
 
   friend bool operator>(const Data &lhs, const Data &rhs) {
     assert(lhs.arith && rhs.arith);
-    return lhs.value > rhs.value;
+    return compare(lhs, rhs) > 0;
   }
 
   friend bool operator>=(const Data &lhs, const Data &rhs) {
     assert(lhs.arith && rhs.arith);
-    return lhs.value >= rhs.value;
+    return compare(lhs, rhs) >= 0;
   }
 
   friend bool operator<(const Data &lhs, const Data &rhs) {
     assert(lhs.arith && rhs.arith);
-    return lhs.value < rhs.value;
+    return compare(lhs, rhs) < 0;
   }
 
   friend bool operator<=(const Data &lhs, const Data &rhs) {
     assert(lhs.arith && rhs.arith);
-    return lhs.value <= rhs.value;
+    return compare(lhs, rhs) <= 0;
   }
 
   friend std::ostream& operator<<( std::ostream &out, const Data &d ) {
     assert(d.arith);
-    out << d.value;
+    d.refresh_value();
+    out << d.get_big();
     return out;
   }
 
@@ -264,7 +333,7 @@ public:
      copied */
   Data(const Data &other)
     : arith(other.arith) {
-    if(other.arith) value = other.value;
+    if(other.arith) copy_value(other);
   }
 
   /* Copy assignment operator */
@@ -279,7 +348,137 @@ public:
   Data &operator=(Data &&other) = default;
 
 protected:
-  Bignum value{0};
+  // Some derived classes (i.e. Field) do not keep the numeric value up-to-date
+  // at all times. Instead they set value_dirty and override import_value(),
+  // which will be called the first time the value is needed.
+  void refresh_value() const {
+    if(value_dirty) import_value();
+  }
+
+  virtual void import_value() const { }
+
+  void set_native(native_t v) {
+    native = v;
+    is_native = true;
+    value_dirty = false;
+  }
+
+  // normalizes the value: if it fits, it is stored natively
+  void set_big(Bignum v) {
+    value_dirty = false;
+    if(bignum::to_native(v, &native)) {
+      is_native = true;
+    }
+    else {
+      value = std::move(v);
+      is_native = false;
+    }
+  }
+
+  Bignum get_big() const {
+    if(!is_native) return value;
+    Bignum v;
+    bignum::from_native(v, native);
+    return v;
+  }
+
+  void copy_value(const Data &other) {
+    other.refresh_value();
+    value_dirty = false;
+    is_native = other.is_native;
+    if(is_native) native = other.native;
+    else value = other.value;
+  }
+
+  // bytes are big endian and the value is always positive
+  // const so that it can be used by import_value()
+  void import_bytes(const char *bytes, size_t nbytes) const {
+    const unsigned char *ubytes = reinterpret_cast<const unsigned char *>(bytes);
+    // skip leading zeros, this is cheap and common for wide fields
+    while(nbytes > 0 && *ubytes == 0) {
+      ubytes++; nbytes--;
+    }
+    if(nbytes > sizeof(native_t) ||
+       (nbytes == sizeof(native_t) && (ubytes[0] & 0x80))) {
+      bignum::import_bytes(value, reinterpret_cast<const char *>(ubytes),
+			   nbytes);
+      is_native = false;
+      value_dirty = false;
+      return;
+    }
+    unative_t v = 0;
+    for(size_t i = 0; i < nbytes; i++)
+      v = (v << 8) | ubytes[i];
+    native = v;
+    is_native = true;
+    value_dirty = false;
+  }
+
+  // keep the nbits least significant bits of the value
+  void mask_value(int nbits) {
+    if(is_native) {
+      if(nbits < bignum::native_bits) {
+	native &= (static_cast<native_t>(1) << nbits) - 1;
+	return;
+      }
+      if(native >= 0) return;
+    }
+    Bignum mask(1);
+    mask <<= nbits; mask -= 1;
+    set_big(get_big() & mask);
+  }
+
+private:
+  void shift_left_(const Data &src1, unsigned int src2) {
+    if(src1.is_native) {
+      if(src1.native == 0) {
+	set_native(0);
+	return;
+      }
+      if(src2 < static_cast<unsigned int>(bignum::native_bits)) {
+	native_t res = static_cast<native_t>(
+	  static_cast<unative_t>(src1.native) << src2
+	);
+	// arithmetic shift back to detect overflow
+	if((res >> src2) == src1.native) {
+	  set_native(res);
+	  return;
+	}
+      }
+    }
+    set_big(src1.get_big() << src2);
+  }
+
+  void shift_right_(const Data &src1, unsigned int src2) {
+    if(src1.is_native) {
+      // arithmetic shift, same semantics as GMP (rounding towards -infinity)
+      if(src2 >= static_cast<unsigned int>(bignum::native_bits))
+	set_native((src1.native < 0) ? -1 : 0);
+      else
+	set_native(src1.native >> src2);
+    }
+    else {
+      set_big(src1.value >> src2);
+    }
+  }
+
+  static int compare(const Data &lhs, const Data &rhs) {
+    lhs.refresh_value(); rhs.refresh_value();
+    if(lhs.is_native && rhs.is_native) {
+      return (lhs.native > rhs.native) - (lhs.native < rhs.native);
+    }
+    // a Bignum is always larger (in absolute value) than any native value
+    if(lhs.is_native) return -rhs.value.sign();
+    if(rhs.is_native) return lhs.value.sign();
+    return lhs.value.compare(rhs.value);
+  }
+
+protected:
+  // mutable because a stale value can be refreshed through a const reference
+  mutable native_t native{0};
+  mutable Bignum value{0};
+  mutable bool is_native{true};
+  mutable bool value_dirty{false};
   bool arith{true};
 };
 
@@ -24,6 +24,8 @@
 #include <string>
 #include <functional>
 
+#include <pthread.h>
+
 extern "C" {
 #include "BMI/bmi_port.h"
 }
@@ -45,6 +47,9 @@ public:
 
   ReturnCode port_remove(port_t port_num);
 
+  // the thread which receives the packets and calls the packet handler
+  pthread_t get_rx_thread() const;
+
   void transmit_fn(int port_num, const char *buffer, int len) {
     bmi_port_send(port_mgr, port_num, buffer, len);
   }
@@ -49,7 +49,8 @@ typedef uintptr_t entry_handle_t;
 class EventLogger {
 public:
   EventLogger(std::unique_ptr<TransportIface> transport)
-    : transport_instance(std::move(transport)) { }
+    : transport_instance(std::move(transport)),
+      enabled(!dynamic_cast<TransportNULL *>(transport_instance.get())) { }
 
   // we need the ingress / egress ports, but they are part of the Packet
   void packet_in(const Packet &packet);
@@ -79,6 +80,9 @@ public:
 
 private:
   std::unique_ptr<TransportIface> transport_instance;
+  // messages sent to a NULL transport are dropped anyway, in which case we do
+  // not even build them (and do not compute packet signatures)
+  bool enabled;
 };
 
 extern EventLogger *logger;
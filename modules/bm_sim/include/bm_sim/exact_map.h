@@ -0,0 +1,274 @@
+/* Copyright 2013-present Barefoot Networks, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Antonin Bas (antonin@barefootnetworks.com)
+ *
+ */
+
+#ifndef _BM_EXACT_MAP_H_
+#define _BM_EXACT_MAP_H_
+
+#include <vector>
+#include <algorithm>
+
+#include <cstdint>
+#include <cstring>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "bytecontainer.h"
+
+/* Open-addressing hash map from fixed-width byte keys to handles, used as the
+   index of exact match tables. Slots are organized in groups of 16, with one
+   control byte per slot: empty, deleted or the 7 low bits of the hash of the
+   key in the slot. A lookup compares the control bytes of a whole group at once
+   (with SSE2 when available) and only looks at the keys whose 7 bits match.
+   Keys are stored inline next to their value, so a lookup usually touches one
+   group of control bytes and one slot. The map is sized for max_entries and
+   only grows if more entries than that are inserted; deleted slots are
+   reclaimed by rehashing in place when they fill the map. */
+
+class ExactMap {
+public:
+  typedef uintptr_t value_t;
+
+public:
+  explicit ExactMap(size_t key_width_bytes, size_t max_entries = 0)
+    : key_width_bytes(key_width_bytes),
+      slot_size(sizeof(value_t) +
+		(key_width_bytes + sizeof(value_t) - 1) /
+		sizeof(value_t) * sizeof(value_t)) {
+    // max_entries live entries stay below a load factor of 3/4
+    size_t min_slots = max_entries + max_entries / 3 + 1;
+    size_t groups = 1;
+    while(groups * group_size < min_slots) groups <<= 1;
+    resize(groups);
+  }
+
+  // returns false if the key is already present
+  bool insert(const ByteContainer &key, value_t value) {
+    return insert(key.data(), value);
+  }
+
+  bool insert(const char *key, value_t value) {
+    uint64_t hash = hash_key(key);
+    if(find(key, hash) != npos) return false;
+    if(nb_used + nb_deleted >= max_used) {
+      // grow only if the live entries are too many, otherwise rehashing in
+      // place frees at least 1/8 of the slots
+      rehash(nb_used >= nb_groups * group_size * 3 / 4 ?
+	     nb_groups * 2 : nb_groups);
+    }
+    size_t slot = find_free(hash);
+    if(ctrl[slot] == kDeleted) nb_deleted--;
+    ctrl[slot] = h2(hash);
+    std::memcpy(slot_value(slot), &value, sizeof(value));
+    std::memcpy(slot_key(slot), key, key_width_bytes);
+    nb_used++;
+    return true;
+  }
+
+  // returns false if the key is not present
+  bool remove(const ByteContainer &key) {
+    return remove(key.data());
+  }
+
+  bool remove(const char *key) {
+    size_t slot = find(key, hash_key(key));
+    if(slot == npos) return false;
+    // if the group still has an empty slot, no probe ever went past it, so the
+    // slot can be marked empty instead of deleted
+    size_t group = slot / group_size;
+    if(match_empty(&ctrl[group * group_size]) != 0) {
+      ctrl[slot] = kEmpty;
+    }
+    else {
+      ctrl[slot] = kDeleted;
+      nb_deleted++;
+    }
+    nb_used--;
+    return true;
+  }
+
+  bool has_key(const ByteContainer &key) const {
+    return find(key.data(), hash_key(key.data())) != npos;
+  }
+
+  bool lookup(const ByteContainer &key, value_t *value) const {
+    return lookup(key.data(), value);
+  }
+
+  bool lookup(const char *key, value_t *value) const {
+    size_t slot = find(key, hash_key(key));
+    if(slot == npos) return false;
+    std::memcpy(value, slot_value(slot), sizeof(*value));
+    return true;
+  }
+
+  size_t size() const { return nb_used; }
+
+  void clear() {
+    std::fill(ctrl.begin(), ctrl.end(), kEmpty);
+    nb_used = 0;
+    nb_deleted = 0;
+  }
+
+private:
+  static const size_t group_size = 16;
+  static const size_t npos = static_cast<size_t>(-1);
+  // not static const members, which would need a definition when bound to a
+  // const reference (e.g. by std::fill)
+  enum : int8_t { kEmpty = -128, kDeleted = -2 };
+
+  static int8_t h2(uint64_t hash) { return hash & 0x7f; }
+
+  static uint64_t h1(uint64_t hash) { return hash >> 7; }
+
+  static uint64_t mix(uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+  }
+
+  // keys have a fixed width, so we can hash them 8 bytes at a time
+  uint64_t hash_key(const char *key) const {
+    uint64_t h = key_width_bytes * 0x9e3779b97f4a7c15ULL;
+    size_t n = key_width_bytes;
+    for(; n >= 8; n -= 8, key += 8) {
+      uint64_t w;
+      std::memcpy(&w, key, 8);
+      h = (h ^ w) * 0x9e3779b97f4a7c15ULL;
+      h ^= h >> 29;
+    }
+    if(n > 0) {
+      uint64_t w = 0;
+      std::memcpy(&w, key, n);
+      h = (h ^ w) * 0x9e3779b97f4a7c15ULL;
+    }
+    return mix(h);
+  }
+
+  // bit i of the result is set if control byte i of the group is equal to c
+  static uint32_t match_byte(const int8_t *group, int8_t c) {
+#ifdef __SSE2__
+    __m128i g = _mm_loadu_si128(reinterpret_cast<const __m128i *>(group));
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(g, _mm_set1_epi8(c)));
+#else
+    uint32_t mask = 0;
+    for(size_t i = 0; i < group_size; i++)
+      mask |= static_cast<uint32_t>(group[i] == c) << i;
+    return mask;
+#endif
+  }
+
+  static uint32_t match_empty(const int8_t *group) {
+    return match_byte(group, kEmpty);
+  }
+
+  // empty and deleted are the only negative control bytes
+  static uint32_t match_free(const int8_t *group) {
+#ifdef __SSE2__
+    __m128i g = _mm_loadu_si128(reinterpret_cast<const __m128i *>(group));
+    return _mm_movemask_epi8(g);
+#else
+    uint32_t mask = 0;
+    for(size_t i = 0; i < group_size; i++)
+      mask |= static_cast<uint32_t>(group[i] < 0) << i;
+    return mask;
+#endif
+  }
+
+  static int lowest_bit(uint32_t mask) {
+    return __builtin_ctz(mask);
+  }
+
+  char *slot_value(size_t slot) { return &slots[slot * slot_size]; }
+  const char *slot_value(size_t slot) const { return &slots[slot * slot_size]; }
+
+  char *slot_key(size_t slot) { return slot_value(slot) + sizeof(value_t); }
+  const char *slot_key(size_t slot) const {
+    return slot_value(slot) + sizeof(value_t);
+  }
+
+  // groups are probed quadratically, which visits all of them since their
+  // number is a power of 2; the load factor guarantees an empty slot
+  size_t find(const char *key, uint64_t hash) const {
+    size_t group = h1(hash) & (nb_groups - 1);
+    for(size_t step = 1; ; step++) {
+      const int8_t *g = &ctrl[group * group_size];
+      uint32_t candidates = match_byte(g, h2(hash));
+      while(candidates) {
+	size_t slot = group * group_size + lowest_bit(candidates);
+	if(!std::memcmp(slot_key(slot), key, key_width_bytes)) return slot;
+	candidates &= candidates - 1;
+      }
+      if(match_empty(g)) return npos;
+      group = (group + step) & (nb_groups - 1);
+    }
+  }
+
+  size_t find_free(uint64_t hash) const {
+    size_t group = h1(hash) & (nb_groups - 1);
+    for(size_t step = 1; ; step++) {
+      uint32_t free = match_free(&ctrl[group * group_size]);
+      if(free) return group * group_size + lowest_bit(free);
+      group = (group + step) & (nb_groups - 1);
+    }
+  }
+
+  void resize(size_t groups) {
+    nb_groups = groups;
+    // the load factor, including deleted slots, is at most 7/8
+    max_used = nb_groups * group_size * 7 / 8;
+    ctrl.assign(nb_groups * group_size, kEmpty);
+    slots.assign(nb_groups * group_size * slot_size, 0);
+  }
+
+  // gets rid of the deleted slots
+  void rehash(size_t groups) {
+    std::vector<int8_t> old_ctrl;
+    std::vector<char> old_slots;
+    old_ctrl.swap(ctrl);
+    old_slots.swap(slots);
+    resize(groups);
+    for(size_t slot = 0; slot < old_ctrl.size(); slot++) {
+      if(old_ctrl[slot] < 0) continue;
+      const char *src = &old_slots[slot * slot_size];
+      size_t dst = find_free(hash_key(src + sizeof(value_t)));
+      ctrl[dst] = old_ctrl[slot];
+      std::memcpy(slot_value(dst), src, slot_size);
+    }
+    nb_deleted = 0;
+  }
+
+private:
+  size_t key_width_bytes{0};
+  size_t slot_size{0};
+  size_t nb_groups{0};
+  size_t max_used{0};
+  size_t nb_used{0};
+  size_t nb_deleted{0};
+  std::vector<int8_t> ctrl{};
+  // each slot is the value followed by the key, padded to a multiple of 8
+  std::vector<char> slots{};
+};
+
+#endif
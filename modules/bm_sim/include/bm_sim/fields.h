@@ -36,9 +36,6 @@ public:
   Field(int nbits, bool arith_flag = true)
     : nbits(nbits), nbytes( (nbits + 7) / 8 ), bytes(nbytes) {
     arith = arith_flag;
-    // TODO ?
-    // should I only do that for arith fields ?
-    mask <<= nbits; mask -= 1;
   }
 
   // Overload set? Make it more generic (arbitary length) ?
@@ -46,14 +43,15 @@ public:
   void set_bytes(const char *src_bytes, int len) {
     assert(len == nbytes);
     std::copy(src_bytes, src_bytes + len, bytes.begin());
-    if(arith) sync_value();
+    bytes_updated();
   }
   
   void sync_value() {
-    bignum::import_bytes(value, bytes.data(), nbytes);
+    import_bytes(bytes.data(), nbytes);
   }
 
   const ByteContainer &get_bytes() const {
+    if(bytes_dirty) sync_bytes();
     return bytes;
   }
 
@@ -65,16 +63,23 @@ public:
     return nbits;
   }
 
-  void set_arith(bool arith_flag) { arith = arith_flag; }
+  void set_arith(bool arith_flag) {
+    // the value may never have been imported for a non-arith field
+    if(arith_flag && !arith && !bytes_dirty) value_dirty = true;
+    arith = arith_flag;
+  }
+
+  // makes both the bytes and the value up-to-date, after which the field can
+  // be read concurrently
+  void sync() const {
+    if(bytes_dirty) sync_bytes();
+    refresh_value();
+  }
 
+  // the bytes will only be computed from the value when someone needs them
   void export_bytes() {
-    std::fill(bytes.begin(), bytes.end(), 0); // very important !
-    // TODO: this can overflow !!!
-    // maybe bytes is not large enough !!!
-    // I am supposed to mask off extra bits...
-    // is this efficient enough:
-    value &= mask;
-    bignum::export_bytes(bytes.data(), nbytes, value);
+    mask_value(nbits);
+    bytes_dirty = true;
   }
 
   /* returns the number of bits extracted */
@@ -83,11 +88,40 @@ public:
   /* returns the number of bits deparsed */
   int deparse(char *data, int hdr_offset) const;
 
+private:
+  // to be called after the bytes have been written directly, the value will
+  // only be computed from the bytes when someone needs it
+  void bytes_updated() {
+    bytes_dirty = false;
+    if(arith) value_dirty = true;
+  }
+
+  void import_value() const override {
+    import_bytes(bytes.data(), nbytes);
+  }
+
+  void sync_bytes() const {
+    bytes_dirty = false;
+    if(is_native) {
+      // the value is positive after masking
+      unative_t v = static_cast<unative_t>(native);
+      for(int i = nbytes - 1; i >= 0; i--) {
+	bytes[i] = static_cast<char>(v & 0xff);
+	v >>= 8;
+      }
+      return;
+    }
+    std::fill(bytes.begin(), bytes.end(), 0); // very important !
+    bignum::export_bytes(bytes.data(), nbytes, value);
+  }
+
 private:
   int nbits;
   int nbytes;
-  ByteContainer bytes;
-  Bignum mask{1};
+  // if bytes_dirty is set, the value is authoritative and the bytes are
+  // out-of-date; if value_dirty is set, it is the other way around
+  mutable ByteContainer bytes;
+  mutable bool bytes_dirty{false};
 };
 
 #endif
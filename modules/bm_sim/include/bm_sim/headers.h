@@ -23,7 +23,9 @@
 
 #include <vector>
 #include <string>
+#include <cstdint>
 #include <set>
+#include <algorithm>
 
 #include "fields.h"
 #include "named_p4object.h"
@@ -31,6 +33,22 @@
 typedef p4object_id_t header_type_id_t;
 
 class HeaderType : public NamedP4Object {
+public:
+  // The extraction / deparsing plan is built when the fields are pushed, so
+  // that Header::extract() and Header::deparse() do not have to recompute the
+  // position of each field for every packet. Consecutive byte-aligned fields
+  // are grouped in a single COPY step, the other fields each get a SHIFT step.
+  struct PlanStep {
+    enum class Type { COPY, SHIFT };
+
+    Type type;
+    int byte_offset; // offset in the header of the first byte
+    int bit_offset; // SHIFT only: offset of the first bit in that byte
+    int nbytes; // number of bytes spanned in the header
+    int field_begin; // index of the first field in the step
+    int field_end; // index of the last field in the step + 1
+  };
+
 public:
   HeaderType(const std::string &name, p4object_id_t id)
     : NamedP4Object(name, id) {}
@@ -39,7 +57,9 @@ public:
   int push_back_field(const std::string &field_name, int field_bit_width) {
     fields_bit_width.push_back(field_bit_width);
     fields_name.push_back(field_name);
-    return fields_bit_width.size() - 1;
+    int field_offset = fields_bit_width.size() - 1;
+    push_back_plan_step(field_offset, field_bit_width);
+    return field_offset;
   }
 
   int get_bit_width(int field_offset) const {
@@ -72,33 +92,72 @@ public:
     return -1;
   }
 
+  const std::vector<PlanStep> &get_plan() const { return plan; }
+
+private:
+  void push_back_plan_step(int field_offset, int field_bit_width) {
+    int byte_offset = plan_bit_width / 8;
+    int bit_offset = plan_bit_width % 8;
+    plan_bit_width += field_bit_width;
+    if(bit_offset == 0 && field_bit_width % 8 == 0) {
+      int nbytes = field_bit_width / 8;
+      if(!plan.empty() && plan.back().type == PlanStep::Type::COPY &&
+	 plan.back().byte_offset + plan.back().nbytes == byte_offset) {
+	plan.back().nbytes += nbytes;
+	plan.back().field_end++;
+      }
+      else {
+	plan.push_back({PlanStep::Type::COPY, byte_offset, 0, nbytes,
+	      field_offset, field_offset + 1});
+      }
+    }
+    else {
+      int nbytes = (bit_offset + field_bit_width + 7) / 8;
+      plan.push_back({PlanStep::Type::SHIFT, byte_offset, bit_offset, nbytes,
+	    field_offset, field_offset + 1});
+    }
+  }
+
 private:
   std::vector<int> fields_bit_width{};
   std::vector<std::string> fields_name{};
+  std::vector<PlanStep> plan{};
+  int plan_bit_width{0};
+};
+
+// Owned by the PHV and shared by all of its headers. Incrementing valid
+// invalidates all the headers at once, incrementing metadata zeroes all the
+// metadata headers at once (their fields are zeroed lazily, on first access).
+struct PHVGenerations {
+  uint64_t valid{1};
+  uint64_t metadata{1};
 };
 
 class Header : public NamedP4Object
 {
 public:
-  typedef std::vector<Field>::iterator iterator;
-  typedef std::vector<Field>::const_iterator const_iterator;
-  typedef std::vector<Field>::reference reference;
-  typedef std::vector<Field>::const_reference const_reference;
+  typedef Field *iterator;
+  typedef const Field *const_iterator;
+  typedef Field &reference;
+  typedef const Field &const_reference;
   typedef size_t size_type;
 
   friend class PHV;
 
 public:
+  // The fields are not owned by the header, they live in the PHV field storage
+  // (see PHV) and need to have been constructed already. fields points to the
+  // first one.
   Header(const std::string &name, p4object_id_t id,
-	 const HeaderType &header_type, const std::set<int> &arith_offsets,
-	 const bool metadata = false);
+	 const HeaderType &header_type, Field *fields,
+	 const PHVGenerations &generations, const bool metadata = false);
 
   int get_nbytes_packet() const {
     return nbytes_packet;
   }
 
   bool is_valid() const {
-    return (metadata || valid);
+    return (metadata || valid_generation == generations->valid);
   }
 
   bool is_metadata() const {
@@ -106,24 +165,29 @@ public:
   }
 
   void mark_valid() {
-    valid = true;
+    valid_generation = generations->valid;
   }
 
   void mark_invalid() {
-    valid = false;
+    valid_generation = 0;
   }
 
   void reset() {
-    for(Field &f : fields)
-      f.set(0);
+    if(metadata)
+      reset_generation = 0;
+    else
+      zero_fields();
   }
 
   // prefer operator [] to those functions
   Field &get_field(int field_offset) {
+    refresh();
+    unshare();
     return fields[field_offset];
   }
   const Field &get_field(int field_offset) const {
-    return fields[field_offset];
+    refresh();
+    return get_fields()[field_offset];
   }
 
   const HeaderType &get_header_type() const { return header_type; }
@@ -137,37 +201,81 @@ public:
   void deparse(char *data) const;
 
   // return the number of fields
-  size_type size() const noexcept { return fields.size(); }
+  size_type size() const noexcept { return num_fields; }
 
   // iterators
-  iterator begin() { return fields.begin(); }
+  iterator begin() { refresh(); unshare(); return fields; }
 
-  const_iterator begin() const { return fields.begin(); }
+  const_iterator begin() const { refresh(); return get_fields(); }
 
-  iterator end() { return fields.end(); }
+  iterator end() { refresh(); unshare(); return fields + num_fields; }
 
-  const_iterator end() const { return fields.end(); }
+  const_iterator end() const { refresh(); return get_fields() + num_fields; }
 
   reference operator[](size_type n) {
-    assert(n < fields.size());
+    assert(n < num_fields);
+    refresh();
+    unshare();
     return fields[n];
   }
 
   const_reference operator[](size_type n) const {
-    assert(n < fields.size());
-    return fields[n];
+    assert(n < num_fields);
+    refresh();
+    return get_fields()[n];
   }
 
   // useful for header stacks
   void swap_values(Header &other) {
-    std::swap(valid, other.valid);
+    refresh();
+    other.refresh();
+    unshare();
+    other.unshare();
+    std::swap(valid_generation, other.valid_generation);
     // cannot do that, would invalidate references
     // std::swap(fields, other.fields);
-    for(size_t i = 0; i < fields.size(); i++) {
+    for(size_t i = 0; i < num_fields; i++) {
       std::swap(fields[i], other.fields[i]);
     }
   }
 
+  // copies the field values, both headers need to have the same type
+  void copy_fields(const Header &src) {
+    assert(num_fields == src.num_fields);
+    src.refresh();
+    const Field *src_fields = src.get_fields();
+    std::copy(src_fields, src_fields + num_fields, fields);
+    cow_src = nullptr;
+    reset_generation = generations->metadata;
+  }
+
+  // Makes this header a copy-on-write view of src: const accesses read the
+  // fields of src, the first non-const access copies them. src must not be
+  // modified for as long as this header shares its fields (see PHV).
+  void share_fields(const Header &src) {
+    assert(num_fields == src.num_fields);
+    src.refresh();
+    cow_src = src.cow_src ? src.cow_src : &src;
+    reset_generation = generations->metadata;
+  }
+
+  // stops sharing without copying, the field values are then undefined
+  void unlink() { cow_src = nullptr; }
+
+  // brings all the fields up-to-date, so that the header can safely be read
+  // by several threads
+  void sync() const {
+    refresh();
+    if(cow_src) return;
+    for(size_t i = 0; i < num_fields; i++)
+      fields[i].sync();
+  }
+
+  bool shares_fields_with(const Header &src) const {
+    refresh();
+    return cow_src && cow_src == (src.cow_src ? src.cow_src : &src);
+  }
+
   Header(const Header &other) = delete;
   Header &operator=(const Header &other) = delete;
 
@@ -175,10 +283,41 @@ public:
   Header(Header &&other) = default;
   Header &operator=(Header &&other) = default;
 
+private:
+  // a metadata header whose reset_generation is out of date has been reset
+  // since the last access and still needs its fields to be zeroed
+  void refresh() const {
+    if(metadata && reset_generation != generations->metadata)
+      zero_fields();
+  }
+
+  void zero_fields() const {
+    for(size_t i = 0; i < num_fields; i++)
+      fields[i].set(0);
+    cow_src = nullptr;
+    reset_generation = generations->metadata;
+  }
+
+  const Field *get_fields() const {
+    return cow_src ? cow_src->fields : fields;
+  }
+
+  void unshare() {
+    if(!cow_src) return;
+    std::copy(cow_src->fields, cow_src->fields + num_fields, fields);
+    cow_src = nullptr;
+  }
+
 private:
   const HeaderType &header_type;
-  std::vector<Field> fields{};
-  bool valid{false};
+  Field *fields{nullptr};
+  size_t num_fields{0};
+  const PHVGenerations *generations{nullptr};
+  // the header is valid iff this is equal to generations->valid
+  uint64_t valid_generation{0};
+  mutable uint64_t reset_generation{0};
+  // never itself a view, the PHV keeps it alive
+  mutable const Header *cow_src{nullptr};
   bool metadata{false};
   int nbytes_phv{0};
   int nbytes_packet{0};
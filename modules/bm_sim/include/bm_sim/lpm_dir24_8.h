@@ -0,0 +1,109 @@
+/* Copyright 2013-present Barefoot Networks, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Antonin Bas (antonin@barefootnetworks.com)
+ *
+ */
+
+#ifndef _BM_LPM_DIR24_8_H_
+#define _BM_LPM_DIR24_8_H_
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#include <cstdint>
+
+#include "lpm_trie.h"
+
+/* DIR-24-8 for keys made of a 32-bit value (e.g. an IPv4 address), possibly
+   preceded by a few valid bytes. There is one table of 2^24 entries indexed by
+   the first 24 bits of the value for each combination of the valid bytes (each
+   one being 0 or 1), allocated on first use. An entry holds either the value of
+   the longest prefix covering it or, if longer prefixes exist in its range, the
+   index of a group of 256 entries indexed by the last 8 bits. A lookup thus
+   takes one or two memory accesses. Each entry records the length of its
+   prefix, so that inserting or deleting a prefix only rewrites its own
+   range. The prefixes themselves are also kept in a hash map per length, to
+   find which prefix takes over a range when one is deleted. Values must be
+   less than max_value. */
+
+class LPMDir24_8 : public LPMIndex {
+public:
+  static const uintptr_t max_value = (1u << 25) - 1;
+  static const size_t max_valid_bytes = 3;
+  // each table of 2^24 entries takes 64MB, so DIR-24-8 is only used by default
+  // for tables at least this large, and without valid bytes
+  static const size_t min_default_size = 1 << 16;
+
+public:
+  // key_width_bytes is 4 plus the number of valid bytes
+  explicit LPMDir24_8(size_t key_width_bytes);
+
+  void insert_prefix(const ByteContainer &prefix, int prefix_length,
+		     uintptr_t value) override;
+
+  bool delete_prefix(const ByteContainer &prefix, int prefix_length) override;
+
+  bool has_prefix(const ByteContainer &prefix,
+		  int prefix_length) const override;
+
+  bool lookup(const ByteContainer &key, uintptr_t *value) const override;
+
+  void clear() override;
+
+private:
+  // bit 31 is set for a group index, otherwise bits 25 to 30 are the prefix
+  // length and bits 0 to 24 are the value + 1 (0 if there is no prefix)
+  static const uint32_t group_flag = 1u << 31;
+  static const int length_shift = 25;
+  static const uint32_t value_mask = (1u << 25) - 1;
+
+  static uint32_t make_entry(int prefix_length, uintptr_t value) {
+    return (static_cast<uint32_t>(prefix_length) << length_shift) |
+      static_cast<uint32_t>(value + 1);
+  }
+
+  static int entry_length(uint32_t entry) {
+    return (entry >> length_shift) & 0x3f;
+  }
+
+  std::string masked_key(const char *bytes, int prefix_length) const;
+
+  std::string combination_key(size_t combination,
+			      const std::string &prefix) const;
+
+  uint32_t best_entry(const std::string &key, int max_length) const;
+
+  void set_range(size_t combination, uint32_t value, int value_length,
+		 int prefix_length, uint32_t entry, bool insert);
+
+  uint32_t new_group(uint32_t entry);
+
+private:
+  size_t key_width_bytes{0};
+  size_t nb_valid{0};
+  // one table per combination of the valid bytes
+  std::vector<std::vector<uint32_t> > tables24{};
+  std::vector<uint32_t> tables8{};
+  // number of prefixes longer than 24 bits in each group
+  std::vector<uint32_t> group_prefixes{};
+  std::vector<uint32_t> free_groups{};
+  // one map per prefix length, from the masked prefix to the value
+  std::vector<std::unordered_map<std::string, uintptr_t> > prefixes{};
+};
+
+#endif
@@ -0,0 +1,146 @@
+/* Copyright 2013-present Barefoot Networks, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Antonin Bas (antonin@barefootnetworks.com)
+ *
+ */
+
+#ifndef _BM_LPM_POPTRIE_H_
+#define _BM_LPM_POPTRIE_H_
+
+#include <string>
+#include <vector>
+#include <map>
+#include <utility>
+
+#include <cstdint>
+
+#include "lpm_trie.h"
+
+/* Poptrie, for wide keys (e.g. IPv6 addresses). The first top_bits bits of the
+   key index a table which points either to a value or to a node. Each node
+   consumes the next 6 bits: its 64 children are either nodes, all contiguous in
+   the node array, or leaves, stored once per run of identical values in the
+   leaf array. Two 64-bit bitmaps tell which children are nodes and where runs
+   of leaves start, and the position of a child in its array is found with a
+   popcount. Values are pushed to the leaves, so a lookup stops at the first
+   leaf without backtracking.
+
+   The prefixes are also kept in an ordered map, from which the nodes covered by
+   a prefix are built again when it is inserted or deleted. Nodes which keep the
+   same children are updated in place, otherwise their children are allocated
+   again. The old nodes and leaves are garbage collected once they take more
+   space than the live ones. Within a batch, only the map is updated, and all
+   the nodes are built at the end, which is much faster for a large number of
+   prefixes. The top table is allocated on the first insert. Values must be
+   less than max_value. */
+
+class LPMPoptrie : public LPMIndex {
+public:
+  static const uintptr_t max_value = (1u << 31) - 1;
+  static const int top_bits = 18;
+  static const int stride = 6;
+
+public:
+  // key_width_bytes has to be at least 3
+  explicit LPMPoptrie(size_t key_width_bytes);
+
+  void insert_prefix(const ByteContainer &prefix, int prefix_length,
+		     uintptr_t value) override;
+
+  bool delete_prefix(const ByteContainer &prefix, int prefix_length) override;
+
+  bool has_prefix(const ByteContainer &prefix,
+		  int prefix_length) const override;
+
+  bool lookup(const ByteContainer &key, uintptr_t *value) const override;
+
+  void clear() override;
+
+  void begin_batch() override { in_batch = true; }
+
+  void end_batch() override;
+
+  // number of nodes in use, without the garbage
+  size_t get_num_nodes() const { return nodes.size() - garbage_nodes; }
+
+private:
+  // top table entries and leaves are value + 1 (0 if there is no prefix), or
+  // a node index with node_flag set for the top table
+  static const uint32_t node_flag = 1u << 31;
+
+  struct Node {
+    // children which are nodes
+    uint64_t vector;
+    // children which are leaves and start a new run of leaves
+    uint64_t leafvec;
+    // first leaf in leaves
+    uint32_t base0;
+    // first child in nodes
+    uint32_t base1;
+  };
+
+  // masked prefix, prefix length -> value; sorted by prefix first, so all the
+  // prefixes below an entry of the top table are next to each other
+  typedef std::map<std::pair<std::string, int>, uintptr_t> Rib;
+
+  uint32_t get_bits(const char *key, int offset, int nbits) const;
+
+  std::string masked_key(const char *bytes, int prefix_length) const;
+
+  void set_top_range(const std::string &prefix, int prefix_length,
+		     uint32_t leaf, int leaf_length, bool insert);
+
+  bool same_bits(const std::string &key, const std::string &prefix,
+		 int nbits) const;
+
+  std::vector<Rib::const_iterator> get_prefixes_below(const std::string &path,
+						      int offset) const;
+
+  void rebuild(uint32_t top_index);
+
+  void rebuild_path(const std::string &prefix, int prefix_length);
+
+  void build_node(uint32_t node, int offset, uint32_t leaf,
+		  const Rib::const_iterator *first,
+		  const Rib::const_iterator *last, bool in_place,
+		  uint32_t first_child = 0, uint32_t last_child = 64);
+
+  void count_nodes(uint32_t node, size_t *num_nodes, size_t *num_leaves) const;
+
+  void allocate_top();
+
+  void collect_garbage();
+
+  void rebuild_all();
+
+private:
+  size_t key_width_bytes{0};
+  Rib rib{};
+  std::vector<uint32_t> top{};
+  // value + 1 and length of the longest prefix of at most top_bits bits
+  // covering each entry of the top table
+  std::vector<uint32_t> top_leaf{};
+  std::vector<uint8_t> top_length{};
+  std::vector<Node> nodes{};
+  std::vector<uint32_t> leaves{};
+  size_t garbage_nodes{0};
+  size_t garbage_leaves{0};
+  // only the rib is updated, everything is built by end_batch()
+  bool in_batch{false};
+};
+
+#endif
@@ -23,7 +23,37 @@
 
 #include <bf_lpm_trie/bf_lpm_trie.h>
 
-class LPMTrie {
+#include "bytecontainer.h"
+
+/* The structures which can hold the prefixes of a LPM match unit. Prefix
+   lengths are counted from the start of the key, and a lookup returns the value
+   of the longest prefix which matches the key. */
+
+class LPMIndex {
+public:
+  virtual ~LPMIndex() { }
+
+  virtual void insert_prefix(const ByteContainer &prefix, int prefix_length,
+			     uintptr_t value) = 0;
+
+  virtual bool delete_prefix(const ByteContainer &prefix,
+			     int prefix_length) = 0;
+
+  virtual bool has_prefix(const ByteContainer &prefix,
+			  int prefix_length) const = 0;
+
+  virtual bool lookup(const ByteContainer &key, uintptr_t *value) const = 0;
+
+  virtual void clear() = 0;
+
+  // the prefixes inserted or deleted in between may only be taken into account
+  // by end_batch(), so no lookup can happen before it
+  virtual void begin_batch() { }
+
+  virtual void end_batch() { }
+};
+
+class LPMTrie : public LPMIndex {
 public:
   LPMTrie(size_t key_width_bytes)
     : key_width_bytes(key_width_bytes) {
@@ -52,23 +82,24 @@ public:
   }
 
   void insert_prefix(const ByteContainer &prefix, int prefix_length,
-		     uintptr_t value) {
+		     uintptr_t value) override {
     bf_lpm_trie_insert(trie, prefix.data(), prefix_length, (value_t) value);
   }
 
-  bool delete_prefix(const ByteContainer &prefix, int prefix_length) {
+  bool delete_prefix(const ByteContainer &prefix, int prefix_length) override {
     return bf_lpm_trie_delete(trie, prefix.data(), prefix_length);
   }
 
-  bool has_prefix(const ByteContainer &prefix, int prefix_length) const {
+  bool has_prefix(const ByteContainer &prefix,
+		  int prefix_length) const override {
     return bf_lpm_trie_has_prefix(trie, prefix.data(), prefix_length);
   }
 
-  bool lookup(const ByteContainer &key, uintptr_t *value) const {
+  bool lookup(const ByteContainer &key, uintptr_t *value) const override {
     return bf_lpm_trie_lookup(trie, key.data(), (value_t *) value);
   }
 
-  void clear() {
+  void clear() override {
     bf_lpm_trie_destroy(trie);
     trie = bf_lpm_trie_create(key_width_bytes, true);
   }
@@ -152,6 +152,20 @@ public:
 			   entry_handle_t *handle,
 			   int priority = -1);
 
+  struct NewEntry {
+    std::vector<MatchKeyParam> match_key;
+    const ActionFn *action_fn;
+    ActionData action_data;
+    int priority;
+  };
+
+  // adds all the entries under a single lock, letting the match unit index
+  // them all at once (see MatchUnitAbstract::begin_bulk_add); rcs and handles
+  // get one element per entry
+  void add_entries(std::vector<NewEntry> entries, // move it
+		   std::vector<MatchErrorCode> *rcs,
+		   std::vector<entry_handle_t> *handles);
+
   MatchErrorCode delete_entry(entry_handle_t handle);
 
   MatchErrorCode modify_entry(entry_handle_t handle,
@@ -176,7 +190,7 @@ public:
 
 public:
   static std::unique_ptr<MatchTable> create(
-    const std::string &match_type, 
+    const std::string &match_type, const std::string &match_algo,
     const std::string &name, p4object_id_t id,
     size_t size, const MatchKeyBuilder &match_key_builder,
     bool with_counters, bool with_ageing
@@ -304,6 +318,17 @@ public:
 			   entry_handle_t *handle,
 			   int priority = -1);
 
+  struct NewEntry {
+    std::vector<MatchKeyParam> match_key;
+    mbr_hdl_t mbr;
+    int priority;
+  };
+
+  // same as MatchTable::add_entries
+  void add_entries(const std::vector<NewEntry> &entries,
+		   std::vector<MatchErrorCode> *rcs,
+		   std::vector<entry_handle_t> *handles);
+
   MatchErrorCode delete_entry(entry_handle_t handle);
 
   MatchErrorCode modify_entry(entry_handle_t handle, mbr_hdl_t mbr);
@@ -329,7 +354,7 @@ public:
 
 public:
   static std::unique_ptr<MatchTableIndirect> create(
-    const std::string &match_type, 
+    const std::string &match_type, const std::string &match_algo,
     const std::string &name, p4object_id_t id,
     size_t size, const MatchKeyBuilder &match_key_builder,
     bool with_counters, bool with_ageing
@@ -389,6 +414,17 @@ public:
 			      entry_handle_t *handle,
 			      int priority = -1);
 
+  struct NewEntryWS {
+    std::vector<MatchKeyParam> match_key;
+    grp_hdl_t grp;
+    int priority;
+  };
+
+  // same as MatchTable::add_entries
+  void add_entries_ws(const std::vector<NewEntryWS> &entries,
+		      std::vector<MatchErrorCode> *rcs,
+		      std::vector<entry_handle_t> *handles);
+
   MatchErrorCode modify_entry_ws(entry_handle_t handle, grp_hdl_t grp);
 
   MatchErrorCode set_default_group(grp_hdl_t grp);
@@ -404,7 +440,7 @@ public:
 
 public:
   static std::unique_ptr<MatchTableIndirectWS> create(
-    const std::string &match_type, 
+    const std::string &match_type, const std::string &match_algo,
     const std::string &name, p4object_id_t id,
     size_t size, const MatchKeyBuilder &match_key_builder,
     bool with_counters, bool with_ageing
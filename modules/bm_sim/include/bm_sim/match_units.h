@@ -27,6 +27,8 @@
 #include <iostream>
 #include <atomic>
 
+#include <cstring>
+
 // shared_mutex will only be available in C++-14, so for now I'm using boost
 #include <boost/thread/shared_mutex.hpp>
 
@@ -36,6 +38,10 @@
 #include "packet.h"
 #include "handle_mgr.h"
 #include "lpm_trie.h"
+#include "lpm_dir24_8.h"
+#include "lpm_poptrie.h"
+#include "exact_map.h"
+#include "ternary_classifier.h"
 #include "counters.h"
 
 typedef uintptr_t internal_handle_t;
@@ -65,15 +71,30 @@ struct MatchKeyParam {
   int prefix_length{0}; // optional
 };
 
+/* The layout of the key is fixed when the table is created: one byte per valid
+   header, then the bytes of each field in turn. Building a key is then just a
+   copy of each field (or a memset if its header is not valid) at a known
+   offset in a buffer of get_nbytes_key() bytes. */
+
 struct MatchKeyBuilder
 {
+  struct KeyField {
+    KeyField(header_id_t header, int field_offset, size_t nbytes)
+      : header(header), field_offset(field_offset), nbytes(nbytes) { }
+
+    header_id_t header;
+    int field_offset;
+    size_t nbytes;
+  };
+
   std::vector<header_id_t> valid_headers{};
-  std::vector<std::pair<header_id_t, int> > fields{};
+  std::vector<KeyField> fields{};
   size_t nbytes_key{0};
 
   void push_back_field(header_id_t header, int field_offset, size_t nbits) {
-    fields.push_back(std::pair<header_id_t, int>(header, field_offset));
-    nbytes_key += (nbits + 7) / 8;
+    size_t nbytes = (nbits + 7) / 8;
+    fields.push_back(KeyField(header, field_offset, nbytes));
+    nbytes_key += nbytes;
   }
 
   void push_back_valid_header(header_id_t header) {
@@ -81,28 +102,33 @@ struct MatchKeyBuilder
     nbytes_key++;
   }
 
-  void operator()(const PHV &phv, ByteContainer &key) const
+  // key has to be at least get_nbytes_key() bytes long
+  void operator()(const PHV &phv, char *key) const
   {
     for(const auto &h : valid_headers) {
-      key.push_back(phv.get_header(h).is_valid() ? '\x01' : '\x00');
+      *key++ = phv.get_header(h).is_valid() ? '\x01' : '\x00';
     }
-    for(const auto &p : fields) {
+    for(const auto &f : fields) {
       // we do not reset all fields to 0 in between packets
       // so I need this hack if the P4 programmer assumed that:
       // field not valid => field set to 0
-      // const Field &field = phv.get_field(p.first, p.second);
-      // key.append(field.get_bytes());
-      const Header &header = phv.get_header(p.first);
-      const Field &field = header[p.second];
+      const Header &header = phv.get_header(f.header);
       if(header.is_valid()) {
-	key.append(field.get_bytes());
+	std::memcpy(key, header[f.field_offset].get_bytes().data(), f.nbytes);
       }
       else {
-	key.append(std::string(field.get_nbytes(), '\x00'));
+	std::memset(key, 0, f.nbytes);
       }
+      key += f.nbytes;
     }
   }
 
+  void operator()(const PHV &phv, ByteContainer &key) const
+  {
+    key.resize(nbytes_key);
+    (*this)(phv, key.data());
+  }
+
   size_t get_nbytes_key() const { return nbytes_key; }
 };
 
@@ -198,7 +224,7 @@ protected:
   MatchErrorCode unset_handle(internal_handle_t handle);
   bool valid_handle_(internal_handle_t handle) const;
 
-  // TODO: change key to pointer
+  // the key is resized to nbytes_key and overwritten
   void build_key(const PHV &phv, ByteContainer &key) const {
     match_key_builder(phv, key);
   }
@@ -264,6 +290,13 @@ public:
 
   void reset_state();
 
+  // the entries added in between are only indexed by end_bulk_add(), which is
+  // much faster than indexing them one by one for some match units; no lookup
+  // or deletion can happen in between
+  void begin_bulk_add() { begin_bulk_add_(); }
+
+  void end_bulk_add() { end_bulk_add_(); }
+
 private:
   virtual MatchErrorCode add_entry_(const std::vector<MatchKeyParam> &match_key,
 				    V value, // by value for possible std::move
@@ -281,6 +314,10 @@ private:
   virtual void reset_state_() = 0;
 
   virtual MatchUnitLookup lookup_key(const ByteContainer &key) const = 0;
+
+  virtual void begin_bulk_add_() { }
+
+  virtual void end_bulk_add_() { }
 };
 
 template <typename V>
@@ -292,9 +329,8 @@ public:
 public:
   MatchUnitExact(size_t size, const MatchKeyBuilder &match_key_builder)
     : MatchUnitAbstract<V>(size, match_key_builder),
-      entries(size) {
-    entries_map.reserve(size);
-  }
+      entries(size),
+      entries_map(this->nbytes_key, size) { }
 
 private:
   struct Entry {
@@ -328,8 +364,7 @@ private:
 
 private:
   std::vector<Entry> entries{};
-  std::unordered_map<ByteContainer, entry_handle_t, ByteContainerKeyHash>
-  entries_map{};
+  ExactMap entries_map;
 };
 
 template <typename V>
@@ -339,10 +374,14 @@ public:
   typedef typename MatchUnitAbstract<V>::MatchUnitLookup MatchUnitLookup;
 
 public:
-  MatchUnitLPM(size_t size, const MatchKeyBuilder &match_key_builder)
+  // match_algo can be "dir24_8", "poptrie" or "trie"; by default DIR-24-8 is
+  // used for large tables with a 32-bit key (see LPMDir24_8::min_default_size)
+  // and the trie for everything else
+  MatchUnitLPM(size_t size, const MatchKeyBuilder &match_key_builder,
+	       const std::string &match_algo = "")
     : MatchUnitAbstract<V>(size, match_key_builder),
       entries(size),
-      entries_trie(this->nbytes_key) { }
+      entries_trie(create_index(size, match_key_builder, match_algo)) { }
 
 private:
   struct Entry {
@@ -376,9 +415,18 @@ private:
 
   MatchUnitLookup lookup_key(const ByteContainer &key) const override;
 
+  void begin_bulk_add_() override;
+
+  void end_bulk_add_() override;
+
+  static std::unique_ptr<LPMIndex> create_index(
+    size_t size, const MatchKeyBuilder &match_key_builder,
+    const std::string &match_algo
+  );
+
 private:
   std::vector<Entry> entries{};
-  LPMTrie entries_trie;
+  std::unique_ptr<LPMIndex> entries_trie;
 };
 
 template <typename V>
@@ -388,9 +436,13 @@ public:
   typedef typename MatchUnitAbstract<V>::MatchUnitLookup MatchUnitLookup;
 
 public:
-  MatchUnitTernary(size_t size, const MatchKeyBuilder &match_key_builder)
+  // see TernaryClassifier::create for the possible values of match_algo
+  MatchUnitTernary(size_t size, const MatchKeyBuilder &match_key_builder,
+		   const std::string &match_algo = "")
     : MatchUnitAbstract<V>(size, match_key_builder),
-      entries(size) { }
+      entries(size),
+      rules_index(2 * this->nbytes_key + sizeof(int), size),
+      classifier(TernaryClassifier::create(match_algo, this->nbytes_key)) { }
 
 private:
   struct Entry {
@@ -426,11 +478,23 @@ private:
 
   MatchUnitLookup lookup_key(const ByteContainer &key) const override;
 
+  void begin_bulk_add_() override;
+
+  void end_bulk_add_() override;
+
+  // the key of a rule in rules_index
+  void build_rule_key(const ByteContainer &key, const ByteContainer &mask,
+		      int priority, ByteContainer *rule_key) const;
+
   bool has_rule(const ByteContainer &key, const ByteContainer &mask,
 		int priority) const;
 
 private:
   std::vector<Entry> entries{};
+  // (key, mask, priority) -> handle, to detect duplicate entries
+  ExactMap rules_index;
+  // if null, lookups scan all the entries
+  std::unique_ptr<TernaryClassifier> classifier{nullptr};
 };
 
 #endif
@@ -24,6 +24,7 @@
 #define _BM_OPTIONS_PARSE_H_
 
 #include <string>
+#include <vector>
 #include <map>
 
 class InterfaceList {
@@ -50,14 +51,27 @@ class OptionsParser {
   friend class Switch;
 
 public:
-  void parse(int argc, char *argv[]);
+  // threading_options enables --ingress-threads, --egress-threads,
+  // --priority-queues and --run-to-completion
+  void parse(int argc, char *argv[], bool threading_options = false);
 
 private:
   std::string config_file_path{};
   InterfaceList ifaces{};
   bool pcap{false};
+  bool hugepages{false};
+  bool packet_signatures{true};
   int thrift_port{};
   int device_id{};
+  int ingress_threads{1};
+  int egress_threads{1};
+  int priority_queues{1};
+  bool run_to_completion{false};
+  std::vector<int> ingress_cpus{};
+  std::vector<int> egress_cpus{};
+  std::vector<int> transmit_cpus{};
+  std::vector<int> rx_cpus{};
+  std::vector<int> thrift_cpus{};
   std::string event_logger_addr{};
 };
 
@@ -22,7 +22,6 @@
 #define _BM_PACKET_H_
 
 #include <memory>
-#include <mutex>
 #include <chrono>
 
 #include <cassert>
@@ -92,7 +91,10 @@ public:
     return buffer.pop(bytes);
   }
 
+  // computed the first time it is requested, i.e. usually by the event logger
+  // when the packet is received
   unsigned long long get_signature() const {
+    if(!signature_valid) update_signature();
     return signature;
   }
 
@@ -107,6 +109,14 @@ public:
   Packet clone(packet_id_t new_copy_id) const;
   Packet clone_and_reset_metadata(packet_id_t new_copy_id) const;
 
+  // Same as clone(), but the PHV is not copied. Instead, this packet's PHV is
+  // frozen and both packets get a copy-on-write view of it: a header is only
+  // copied the first time it is accessed through a non-const method. Calling
+  // it repeatedly (e.g. for multicast) reuses the same frozen PHV, as long as
+  // this packet's PHV is not modified in-between. Field references obtained
+  // from this packet's PHV before the call must not be used afterwards.
+  Packet clone_cow(packet_id_t new_copy_id);
+
   Packet(const Packet &other) = delete;
   Packet &operator=(const Packet &other) = delete;
 
@@ -114,9 +124,11 @@ public:
   Packet &operator=(Packet &&other) noexcept;
 
 private:
-  void update_signature(unsigned long long seed = 0);
+  void update_signature(unsigned long long seed = 0) const;
   void set_ingress_ts();
 
+  static void release_phv(std::unique_ptr<PHV> phv);
+
 private:
   int ingress_port{-1};
   int egress_port{-1};
@@ -124,7 +136,8 @@ private:
   packet_id_t copy_id{0};
   int ingress_length{0};
 
-  unsigned long long signature{0};
+  mutable unsigned long long signature{0};
+  mutable bool signature_valid{false};
 
   PacketBuffer buffer{};
 
@@ -134,30 +147,36 @@ private:
   uint64_t ingress_ts_ms{};
 
   std::unique_ptr<PHV> phv{nullptr};
+  // the frozen PHV shared with the copies created by clone_cow()
+  std::shared_ptr<const PHV> shared_phv{nullptr};
 
 private:
-  class PHVPool {
-  public:
-    PHVPool(const PHVFactory &phv_factory);
-    std::unique_ptr<PHV> get();
-    void release(std::unique_ptr<PHV> phv);
-
-  private:
-    mutable std::mutex mutex{};
-    std::vector<std::unique_ptr<PHV> > phvs{};
-    const PHVFactory &phv_factory;
-  };
+  // PHVs are recycled through per-thread caches, see packet.cpp
+  class PHVPool;
 
 public:
   static void set_phv_factory(const PHVFactory &phv_factory);
   static void unset_phv_factory();
   static void swap_phv_factory(const PHVFactory &phv_factory);
 
+  // when disabled, get_signature() always returns 0, without hashing the packet
+  static void set_signatures_enabled(bool enabled);
+
+  // pre-allocates the PHVs and Packet objects for num_packets packets, so that
+  // they do not have to be allocated on the data path
+  static void prewarm(size_t num_packets);
+
+  // Packet objects are recycled through per-thread caches as well
+  static void *operator new(size_t size);
+  static void operator delete(void *ptr, size_t size);
+
 private:
   // static variable
   // Google style guidelines stipulate that we have to use a raw pointer and
   // leak the memory
   static PHVPool *phv_pool;
+
+  static bool signatures_enabled;
 };
 
 #endif
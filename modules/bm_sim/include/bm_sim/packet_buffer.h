@@ -21,10 +21,29 @@
 #ifndef _BM_PACKET_BUFFER_H_
 #define _BM_PACKET_BUFFER_H_
 
-#include <memory>
+#include <algorithm>
+#include <atomic>
 
 #include <cassert>
 
+// Packet buffers are carved out of slabs, one slab per size class (2KB and
+// 9KB). Free buffers are cached per thread in magazines, which are exchanged
+// with a shared depot when they become empty / full. Buffers bigger than the
+// biggest size class are allocated with new.
+class PacketBufferAllocator {
+public:
+  static char *allocate(size_t size);
+  static void deallocate(char *ptr, size_t size);
+
+  // back the slabs allocated from now on with huge pages, if available
+  static void use_hugepages(bool enable);
+};
+
+// The storage of a PacketBuffer is shared (and reference counted) between the
+// buffer and its clones, which makes clone() zero-copy. A shared buffer is
+// immutable: the bytes can be read and popped, but the first push() on a
+// shared buffer copies the data to a private buffer first (unless all the
+// other buffers sharing the storage have been released already).
 class PacketBuffer {
 public:
   PacketBuffer() {}
@@ -32,23 +51,29 @@ public:
   PacketBuffer(size_t size)
     : size(size),
       data_size(0),
-      buffer(std::unique_ptr<char []>(new char[size])),
-      head(buffer.get() + size) {}
+      buffer(PacketBufferAllocator::allocate(size)),
+      head(buffer + size) {}
 
   PacketBuffer(size_t size, const char *data, size_t data_size)
     : size(size),
       data_size(0),
-      buffer(std::unique_ptr<char []>(new char[size])),
-      head(buffer.get() + size) {
+      buffer(PacketBufferAllocator::allocate(size)),
+      head(buffer + size) {
     std::copy(data, data + data_size, push(data_size));
   }
 
+  ~PacketBuffer() {
+    release();
+  }
+
+  // do not write to the data of a shared buffer
   char *start() const { return head; }
 
-  char *end() const { return buffer.get() + size; }
+  char *end() const { return buffer + size; }
   
   char *push(size_t bytes) {
     assert(data_size + bytes <= size);
+    if(shared && bytes > 0) unshare();
     data_size += bytes;
     head -= bytes;
     return head;
@@ -63,24 +88,85 @@ public:
   
   size_t get_data_size() const { return data_size; }
 
+  bool is_shared() const { return shared != nullptr; }
+
+  // shares the storage, no data is copied
   PacketBuffer clone(size_t end_bytes) const {
     assert(end_bytes <= data_size);
-    PacketBuffer pb(size);
-    std::copy(end() - end_bytes, end(), pb.push(end_bytes));
+    if(!shared) shared = new SharedCount();
+    shared->refcount++;
+    PacketBuffer pb;
+    pb.size = size;
+    pb.data_size = end_bytes;
+    pb.buffer = buffer;
+    pb.head = end() - end_bytes;
+    pb.shared = shared;
     return pb;
   }
 
   PacketBuffer(const PacketBuffer &other) = delete;
   PacketBuffer &operator=(const PacketBuffer &other) = delete;
 
-  PacketBuffer(PacketBuffer &&other) /*noexcept*/ = default;
-  PacketBuffer &operator=(PacketBuffer &&other) /*noexcept*/ = default;
+  PacketBuffer(PacketBuffer &&other) noexcept
+    : size(other.size), data_size(other.data_size),
+      buffer(other.buffer), head(other.head), shared(other.shared) {
+    other.size = 0;
+    other.data_size = 0;
+    other.buffer = nullptr;
+    other.head = nullptr;
+    other.shared = nullptr;
+  }
+
+  PacketBuffer &operator=(PacketBuffer &&other) noexcept {
+    std::swap(size, other.size);
+    std::swap(data_size, other.data_size);
+    std::swap(buffer, other.buffer);
+    std::swap(head, other.head);
+    std::swap(shared, other.shared);
+    return *this;
+  }
+
+private:
+  struct SharedCount {
+    // number of buffers sharing the storage
+    std::atomic<int> refcount{1};
+  };
+
+  // returns true iff this was the last reference to a shared storage
+  bool drop_shared() {
+    bool last = (shared->refcount.fetch_sub(1) == 1);
+    if(last) delete shared;
+    shared = nullptr;
+    return last;
+  }
+
+  void unshare() {
+    // if everybody else is gone, we can just keep the storage
+    if(shared->refcount.load() == 1) {
+      delete shared;
+      shared = nullptr;
+      return;
+    }
+    char *new_buffer = PacketBufferAllocator::allocate(size);
+    char *new_head = new_buffer + (head - buffer);
+    std::copy(head, head + data_size, new_head);
+    if(drop_shared()) PacketBufferAllocator::deallocate(buffer, size);
+    buffer = new_buffer;
+    head = new_head;
+  }
+
+  void release() {
+    if(!buffer) return;
+    if(!shared || drop_shared())
+      PacketBufferAllocator::deallocate(buffer, size);
+  }
 
 private:
   size_t size{0};
   size_t data_size{0};
-  std::unique_ptr<char []> buffer{nullptr};
+  char *buffer{nullptr};
   char *head{nullptr};
+  mutable SharedCount *shared{nullptr};
 };
 
 #endif
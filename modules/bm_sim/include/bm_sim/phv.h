@@ -28,8 +28,10 @@
 #include <set>
 #include <map>
 #include <memory>
+#include <utility>
 
 #include <cassert>
+#include <cstdlib>
 
 #include "fields.h"
 #include "headers.h"
@@ -41,6 +43,43 @@ typedef p4object_id_t header_id_t;
 // forward declaration
 class PHVFactory;
 
+// Used for the PHV field storage, so that it starts on a cache line
+template <typename T, size_t Alignment = 64>
+struct AlignedAllocator {
+  typedef T value_type;
+
+  template <typename U>
+  struct rebind { typedef AlignedAllocator<U, Alignment> other; };
+
+  AlignedAllocator() noexcept { }
+
+  template <typename U>
+  AlignedAllocator(const AlignedAllocator<U, Alignment> &) noexcept { }
+
+  T *allocate(size_t n) {
+    void *ptr;
+    if(posix_memalign(&ptr, Alignment, n * sizeof(T)) != 0)
+      throw std::bad_alloc();
+    return static_cast<T *>(ptr);
+  }
+
+  void deallocate(T *ptr, size_t) noexcept {
+    free(ptr);
+  }
+};
+
+template <typename T, typename U, size_t Alignment>
+bool operator==(const AlignedAllocator<T, Alignment> &,
+		const AlignedAllocator<U, Alignment> &) {
+  return true;
+}
+
+template <typename T, typename U, size_t Alignment>
+bool operator!=(const AlignedAllocator<T, Alignment> &,
+		const AlignedAllocator<U, Alignment> &) {
+  return false;
+}
+
 class PHV
 {
 public:
@@ -48,16 +87,17 @@ public:
 
 private:
   typedef std::reference_wrapper<Header> HeaderRef;
-  typedef std::reference_wrapper<Field> FieldRef;
 
 public:
   PHV() {}
 
-  PHV(size_t num_headers, size_t num_header_stacks)
-    : capacity(num_headers), capacity_stacks(num_header_stacks) {
+  PHV(size_t num_headers, size_t num_header_stacks, size_t num_fields)
+    : capacity(num_headers), capacity_stacks(num_header_stacks),
+      capacity_fields(num_fields) {
     // this is needed, otherwise our references will not be valid anymore
     headers.reserve(num_headers);
     header_stacks.reserve(num_header_stacks);
+    fields.reserve(num_fields);
   }
 
   Header &get_header(header_id_t header_index) {
@@ -89,12 +129,15 @@ public:
     return headers[header_index].get_field(field_offset);
   }
 
+  // go through the header, in case the field needs to be zeroed first
   Field &get_field(const std::string &field_name) {
-    return fields_map.at(field_name);
+    const auto &p = fields_map.at(field_name);
+    return get_field(p.first, p.second);
   }
 
   const Field &get_field(const std::string &field_name) const {
-    return fields_map.at(field_name);
+    const auto &p = fields_map.at(field_name);
+    return get_field(p.first, p.second);
   }
 
   bool has_field(const std::string &field_name) const {
@@ -110,7 +153,7 @@ public:
     return header_stacks[header_stack_index];
   }
 
-  void reset(); // mark all headers as invalid
+  void reset(); // mark all headers as invalid, stop sharing
 
   void reset_header_stacks();
 
@@ -119,18 +162,36 @@ public:
   PHV(const PHV &other) = delete;
   PHV &operator=(const PHV &other) = delete;
 
-  PHV(PHV &&other) = default;
-  PHV &operator=(PHV &&other) = default;
+  // the headers point to our generation counters
+  PHV(PHV &&other) = delete;
+  PHV &operator=(PHV &&other) = delete;
 
   void copy_headers(const PHV &src) {
     for(unsigned int h = 0; h < headers.size(); h++) {
-      headers[h].valid = src.headers[h].valid;
       headers[h].metadata = src.headers[h].metadata;
-      if(headers[h].valid || headers[h].metadata)
-	headers[h].fields = src.headers[h].fields;
+      if(src.headers[h].is_valid()) {
+	headers[h].mark_valid();
+	headers[h].copy_fields(src.headers[h]);
+      }
+      else {
+	headers[h].mark_invalid();
+      }
     }
   }
 
+  // Same as copy_headers, except that the field values are not copied: the
+  // headers become copy-on-write views of the headers of src (see
+  // Header::share_fields). src needs to have been synced (see sync()) and
+  // must not be modified afterwards.
+  void share_headers(const std::shared_ptr<const PHV> &src);
+
+  // true iff this PHV was obtained with share_headers(src) and has not been
+  // modified since
+  bool shares_headers_with(const PHV &src) const;
+
+  // brings all the fields up-to-date, see Header::sync()
+  void sync() const;
+
 private:
   // To  be used only by PHVFactory
   // all headers need to be pushed back in order (according to header_index) !!!
@@ -144,8 +205,15 @@ private:
   ) {
     assert(header_index < (int) capacity);
     assert(header_index == (int) headers.size());
+    assert(fields.size() + header_type.get_num_fields() <= capacity_fields);
+    Field *header_fields = fields.data() + fields.size();
+    for(int i = 0; i < header_type.get_num_fields(); i++) {
+      bool arith_flag = (arith_offsets.find(i) != arith_offsets.end());
+      fields.emplace_back(header_type.get_bit_width(i), arith_flag);
+    }
     headers.push_back(
-      Header(header_name, header_index, header_type, arith_offsets, metadata)
+      Header(header_name, header_index, header_type, header_fields,
+	     generations, metadata)
     );
 
     headers_map.emplace(header_name, get_header(header_index));
@@ -153,7 +221,7 @@ private:
     for(int i = 0; i < header_type.get_num_fields(); i++) {
       const std::string name = header_name + "." + header_type.get_field_name(i);
       // std::cout << header_index << " " << i << " " << name << std::endl;
-      fields_map.emplace(name, get_field(header_index, i));
+      fields_map.emplace(name, std::make_pair(header_index, i));
     }
   }
 
@@ -173,12 +241,20 @@ private:
   }
 
 private:
+  // All the fields of all the headers, stored contiguously in header order.
+  // Headers only point into this storage.
+  std::vector<Field, AlignedAllocator<Field> > fields{};
+  PHVGenerations generations{};
+  // keeps the source of our copy-on-write headers alive
+  std::shared_ptr<const PHV> cow_source{nullptr};
   std::vector<Header> headers{};
   std::vector<HeaderStack> header_stacks{};
   std::unordered_map<std::string, HeaderRef> headers_map{};
-  std::unordered_map<std::string, FieldRef> fields_map{};
+  // header id and field offset
+  std::unordered_map<std::string, std::pair<header_id_t, int> > fields_map{};
   size_t capacity{0};
   size_t capacity_stacks{0};
+  size_t capacity_fields{0};
 };
 
 class PHVFactory
@@ -260,8 +336,13 @@ public:
   }
 
   std::unique_ptr<PHV> create() const {
+    size_t num_fields = 0;
+    for(const auto &e : header_descs)
+      num_fields += e.second.header_type.get_num_fields();
+
     std::unique_ptr<PHV> phv(new PHV(header_descs.size(),
-				     header_stack_descs.size()));
+				     header_stack_descs.size(),
+				     num_fields));
 
     for(const auto &e : header_descs) {
       const HeaderDesc &desc = e.second;
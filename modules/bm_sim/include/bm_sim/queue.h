@@ -22,8 +22,15 @@
 #define _BM_QUEUE_H_
 
 #include <deque>
+#include <vector>
 #include <mutex>
 #include <condition_variable>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <algorithm>
+
+#include <cstdint>
 
 /* TODO: implement non blocking behavior */
 
@@ -63,6 +70,26 @@ public:
     q_not_empty.notify_one();
   }
 
+  // pushes all the items in order (items[0] first) and leaves the vector
+  // empty; with WriteReturn, the items which do not fit are dropped; returns
+  // the number of items pushed
+  size_t push_front_batch(std::vector<T> *items) {
+    std::unique_lock<std::mutex> lock(q_mutex);
+    const size_t n = items->size();
+    size_t i = 0;
+    while(i < n) {
+      while(i < n && is_not_full())
+	queue.push_front(std::move((*items)[i++]));
+      if(i == n || wb == WriteReturn) break;
+      q_not_empty.notify_all();
+      q_not_full.wait(lock);
+    }
+    lock.unlock();
+    items->clear();
+    q_not_empty.notify_all();
+    return i;
+  }
+
   void pop_back(T* pItem) {
     std::unique_lock<std::mutex> lock(q_mutex);
     while(!is_not_empty())
@@ -73,12 +100,33 @@ public:
     q_not_full.notify_one();
   }
 
+  // waits for at least one item, then appends up to max items to the vector;
+  // returns the number of items popped
+  size_t pop_back_batch(std::vector<T> *items, size_t max) {
+    std::unique_lock<std::mutex> lock(q_mutex);
+    while(!is_not_empty())
+      q_not_empty.wait(lock);
+    const size_t n = std::min(max, queue.size());
+    for(size_t i = 0; i < n; i++) {
+      items->push_back(std::move(queue.back()));
+      queue.pop_back();
+    }
+    lock.unlock();
+    q_not_full.notify_all();
+    return n;
+  }
+
   size_t size() {
     q_mutex.lock();
     return queue.size();
     q_mutex.unlock();
   }
 
+  size_t get_capacity() {
+    std::unique_lock<std::mutex> lock(q_mutex);
+    return capacity;
+  }
+
   void set_capacity(const size_t c) {
     // change capacity but does not discard elements
     q_mutex.lock();
@@ -103,4 +151,326 @@ private:
   std::condition_variable q_not_full;
 };
 
+/* Concurrency policies for RingQueue, telling it whether several threads can
+   push (resp. pop) at the same time */
+struct RingQueuePolicy {
+  struct SPSC {
+    static const bool multi_producer = false;
+    static const bool multi_consumer = false;
+  };
+
+  struct MPSC {
+    static const bool multi_producer = true;
+    static const bool multi_consumer = false;
+  };
+
+  struct MPMC {
+    static const bool multi_producer = true;
+    static const bool multi_consumer = true;
+  };
+};
+
+/* Lock-free bounded queue, with the same interface as Queue. It is a ring of
+   cells, each with a sequence number (D. Vyukov's bounded MPMC queue); a
+   single producer / consumer does not need the CAS on its index. The number of
+   cells is the initial capacity rounded up to a power of 2, and set_capacity()
+   cannot go beyond that. A thread which cannot push / pop spins for a while,
+   then yields, and eventually sleeps on a condition variable; the other side
+   only takes the mutex to wake it up if someone is actually sleeping. */
+
+template <class T, class Policy = RingQueuePolicy::MPMC>
+class RingQueue {
+public:
+  enum WriteBehavior { WriteBlock, WriteReturn };
+  enum ReadBehavior { ReadBlock, ReadReturn };
+
+public:
+  RingQueue()
+    : RingQueue(1024) { }
+
+  RingQueue(size_t capacity,
+	    WriteBehavior wb = WriteBlock, ReadBehavior rb = ReadBlock)
+    : nb_cells(round_up_pow2(capacity)), mask(nb_cells - 1),
+      cells(new Cell[nb_cells]), capacity(capacity), wb(wb), rb(rb) {
+    for(size_t i = 0; i < nb_cells; i++)
+      cells[i].sequence.store(i, std::memory_order_relaxed);
+  }
+
+  void push_front(const T &item) {
+    T tmp(item);
+    push_front(std::move(tmp));
+  }
+
+  void push_front(T &&item) {
+    while(!try_push(item)) {
+      if(wb == WriteReturn) return;
+      wait_not_full();
+    }
+    wake_up(consumers_waiting, q_not_empty);
+  }
+
+  // same semantics as Queue::push_front_batch, but free cells are claimed
+  // several at a time
+  size_t push_front_batch(std::vector<T> *items) {
+    const size_t n = items->size();
+    size_t i = 0;
+    while(i < n) {
+      size_t pushed = try_push_batch(items->data() + i, n - i);
+      i += pushed;
+      if(pushed > 0) {
+	wake_up(consumers_waiting, q_not_empty, pushed > 1);
+	continue;
+      }
+      if(wb == WriteReturn) break;
+      wait_not_full();
+    }
+    items->clear();
+    return i;
+  }
+
+  void pop_back(T* pItem) {
+    while(!try_pop(pItem))
+      wait_not_empty();
+    wake_up(producers_waiting, q_not_full);
+  }
+
+  size_t pop_back_batch(std::vector<T> *items, size_t max) {
+    size_t n;
+    while((n = try_pop_batch(items, max)) == 0)
+      wait_not_empty();
+    wake_up(producers_waiting, q_not_full, n > 1);
+    return n;
+  }
+
+  // does not block, returns 0 if the queue is empty
+  size_t try_pop_back_batch(std::vector<T> *items, size_t max) {
+    size_t n = try_pop_batch(items, max);
+    if(n > 0) wake_up(producers_waiting, q_not_full, n > 1);
+    return n;
+  }
+
+  bool empty() const {
+    return !is_not_empty();
+  }
+
+  size_t size() const {
+    size_t h = head.load(std::memory_order_relaxed);
+    size_t t = tail.load(std::memory_order_relaxed);
+    return (t > h) ? (t - h) : 0;
+  }
+
+  size_t get_capacity() const {
+    return capacity.load(std::memory_order_relaxed);
+  }
+
+  void set_capacity(const size_t c) {
+    // change capacity but does not discard elements
+    capacity.store(std::min(c, nb_cells), std::memory_order_relaxed);
+  }
+
+  RingQueue(const RingQueue &) = delete;
+  RingQueue &operator =(const RingQueue &) = delete;
+
+private:
+  struct Cell {
+    std::atomic<size_t> sequence{0};
+    T data{};
+  };
+
+  // padded, to keep the indices on their own cache lines
+  struct Index {
+    std::atomic<size_t> value{0};
+    char pad[64 - sizeof(std::atomic<size_t>)];
+
+    size_t load(std::memory_order order) const { return value.load(order); }
+    void store(size_t v, std::memory_order order) { value.store(v, order); }
+    bool compare_exchange_weak(size_t &expected, size_t desired) {
+      return value.compare_exchange_weak(expected, desired,
+					 std::memory_order_relaxed);
+    }
+  };
+
+  static const int spin_iterations = 128;
+  static const int yield_iterations = 16;
+
+  static size_t round_up_pow2(size_t n) {
+    size_t p = 1;
+    while(p < n) p <<= 1;
+    return p;
+  }
+
+  static void cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#endif
+  }
+
+  // how many more items can be pushed at position pos, according to the
+  // (soft) capacity; pos may be stale and behind head
+  size_t free_slots(size_t pos) const {
+    intptr_t used = (intptr_t) (pos - head.load(std::memory_order_acquire));
+    intptr_t cap = (intptr_t) capacity.load(std::memory_order_relaxed);
+    if(used >= cap) return 0;
+    return (used < 0) ? cap : (cap - used);
+  }
+
+  bool try_push(T &item) {
+    return try_push_batch(&item, 1) == 1;
+  }
+
+  // claims up to n consecutive free cells at once and fills them
+  size_t try_push_batch(T *items, size_t n) {
+    size_t pos = tail.load(std::memory_order_relaxed);
+    size_t count;
+    while(1) {
+      const size_t limit = std::min(n, free_slots(pos));
+      if(limit == 0) return 0;
+      count = 0;
+      while(count < limit &&
+	    cells[(pos + count) & mask].sequence.load(std::memory_order_acquire)
+	    == pos + count)
+	count++;
+      if(count == 0) {
+	// either the ring is full, or another producer claimed the cell
+	size_t t = tail.load(std::memory_order_relaxed);
+	if(t == pos) return 0;
+	pos = t;
+	continue;
+      }
+      if(!Policy::multi_producer) {
+	tail.store(pos + count, std::memory_order_relaxed);
+	break;
+      }
+      if(tail.compare_exchange_weak(pos, pos + count)) break;
+    }
+    for(size_t i = 0; i < count; i++) {
+      Cell &cell = cells[(pos + i) & mask];
+      cell.data = std::move(items[i]);
+      cell.sequence.store(pos + i + 1, std::memory_order_release);
+    }
+    return count;
+  }
+
+  bool try_pop(T *item) {
+    size_t pos = head.load(std::memory_order_relaxed);
+    Cell *cell;
+    while(1) {
+      cell = &cells[pos & mask];
+      size_t seq = cell->sequence.load(std::memory_order_acquire);
+      intptr_t dif = (intptr_t) seq - (intptr_t) (pos + 1);
+      if(dif == 0) {
+	if(!Policy::multi_consumer) {
+	  head.store(pos + 1, std::memory_order_relaxed);
+	  break;
+	}
+	if(head.compare_exchange_weak(pos, pos + 1)) break;
+      }
+      else if(dif < 0) {
+	return false;
+      }
+      else {
+	pos = head.load(std::memory_order_relaxed);
+      }
+    }
+    *item = std::move(cell->data);
+    cell->sequence.store(pos + mask + 1, std::memory_order_release);
+    return true;
+  }
+
+  size_t try_pop_batch(std::vector<T> *items, size_t max) {
+    size_t pos = head.load(std::memory_order_relaxed);
+    size_t count;
+    while(1) {
+      count = 0;
+      while(count < max &&
+	    cells[(pos + count) & mask].sequence.load(std::memory_order_acquire)
+	    == pos + count + 1)
+	count++;
+      if(count == 0) {
+	size_t h = head.load(std::memory_order_relaxed);
+	if(h == pos) return 0;
+	pos = h;
+	continue;
+      }
+      if(!Policy::multi_consumer) {
+	head.store(pos + count, std::memory_order_relaxed);
+	break;
+      }
+      if(head.compare_exchange_weak(pos, pos + count)) break;
+    }
+    for(size_t i = 0; i < count; i++) {
+      Cell &cell = cells[(pos + i) & mask];
+      items->push_back(std::move(cell.data));
+      cell.sequence.store(pos + i + mask + 1, std::memory_order_release);
+    }
+    return count;
+  }
+
+  bool is_not_empty() const {
+    size_t pos = head.load(std::memory_order_relaxed);
+    return cells[pos & mask].sequence.load(std::memory_order_acquire) ==
+      pos + 1;
+  }
+
+  bool is_not_full() const {
+    size_t pos = tail.load(std::memory_order_relaxed);
+    if(free_slots(pos) == 0) return false;
+    return cells[pos & mask].sequence.load(std::memory_order_acquire) == pos;
+  }
+
+  template <typename Pred>
+  void wait(Pred pred, std::atomic<int> &waiting, std::condition_variable &cv) {
+    for(int i = 0; i < spin_iterations; i++) {
+      if(pred()) return;
+      cpu_relax();
+    }
+    for(int i = 0; i < yield_iterations; i++) {
+      if(pred()) return;
+      std::this_thread::yield();
+    }
+    std::unique_lock<std::mutex> lock(q_mutex);
+    waiting.fetch_add(1);
+    // pairs with the fence in wake_up(): either we see the new state of the
+    // queue, or the other side sees that we are waiting
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    cv.wait(lock, pred);
+    waiting.fetch_sub(1);
+  }
+
+  void wait_not_empty() {
+    wait([this]() { return is_not_empty(); }, consumers_waiting, q_not_empty);
+  }
+
+  void wait_not_full() {
+    wait([this]() { return is_not_full(); }, producers_waiting, q_not_full);
+  }
+
+  void wake_up(std::atomic<int> &waiting, std::condition_variable &cv,
+	       bool all = false) {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if(waiting.load(std::memory_order_relaxed) == 0) return;
+    std::unique_lock<std::mutex> lock(q_mutex);
+    if(all) cv.notify_all();
+    else cv.notify_one();
+  }
+
+private:
+  const size_t nb_cells;
+  const size_t mask;
+  std::unique_ptr<Cell []> cells;
+  char pad[64];
+  Index head{};
+  Index tail{};
+  std::atomic<size_t> capacity;
+  WriteBehavior wb;
+  ReadBehavior rb;
+
+  // only used when a thread needs to sleep
+  std::mutex q_mutex{};
+  std::condition_variable q_not_empty{};
+  std::condition_variable q_not_full{};
+  std::atomic<int> consumers_waiting{0};
+  std::atomic<int> producers_waiting{0};
+};
+
 #endif
@@ -30,6 +30,9 @@ public:
   typedef MatchTableIndirect::mbr_hdl_t mbr_hdl_t;
   typedef MatchTableIndirectWS::grp_hdl_t grp_hdl_t;
 
+  typedef MatchTableIndirect::NewEntry IndirectNewEntry;
+  typedef MatchTableIndirectWS::NewEntryWS IndirectWSNewEntry;
+
   typedef Meter::MeterErrorCode MeterErrorCode;
 
 public:
@@ -40,6 +43,13 @@ public:
     NO_ONGOING_SWAP
   };
 
+  struct NewEntry {
+    std::vector<MatchKeyParam> match_key;
+    std::string action_name;
+    ActionData action_data;
+    int priority;
+  };
+
 public:
   virtual ~RuntimeInterface() { }
 
@@ -50,6 +60,15 @@ public:
 	       ActionData action_data, // will be moved
 	       entry_handle_t *handle,
 	       int priority = -1/*only used for ternary*/) = 0;
+
+  // adds all the entries at once, which is much faster for large tables; the
+  // return value is for the table itself, rcs and handles get one element per
+  // entry (INVALID_ACTION_NAME for an entry whose action does not exist)
+  virtual MatchErrorCode
+  mt_add_entries(const std::string &table_name,
+		 std::vector<NewEntry> entries, // will be moved
+		 std::vector<MatchErrorCode> *rcs,
+		 std::vector<entry_handle_t> *handles) = 0;
   
   virtual MatchErrorCode
   mt_set_default_action(const std::string &table_name,
@@ -89,6 +108,12 @@ public:
 			entry_handle_t *handle,
 			int priority = 1) = 0;
 
+  virtual MatchErrorCode
+  mt_indirect_add_entries(const std::string &table_name,
+			  const std::vector<IndirectNewEntry> &entries,
+			  std::vector<MatchErrorCode> *rcs,
+			  std::vector<entry_handle_t> *handles) = 0;
+
   virtual MatchErrorCode
   mt_indirect_modify_entry(const std::string &table_name,
 			   entry_handle_t handle,
@@ -125,6 +150,12 @@ public:
 			   entry_handle_t *handle,
 			   int priority = 1) = 0;
 
+  virtual MatchErrorCode
+  mt_indirect_ws_add_entries(const std::string &table_name,
+			     const std::vector<IndirectWSNewEntry> &entries,
+			     std::vector<MatchErrorCode> *rcs,
+			     std::vector<entry_handle_t> *handles) = 0;
+
   virtual MatchErrorCode
   mt_indirect_ws_modify_entry(const std::string &table_name,
 			      entry_handle_t handle,
@@ -30,12 +30,10 @@ class Register : public Data
 {
 public:
   Register(int nbits)
-    : nbits(nbits) {
-    mask <<= nbits; mask -= 1;
-  }
+    : nbits(nbits) { }
 
   void export_bytes() {
-    value &= mask;
+    mask_value(nbits);
   }
 
 private:
@@ -45,7 +43,6 @@ private:
 
 private:
   int nbits;
-  Bignum mask{1};
   // mutexes are not movable, extra indirection bad?
   std::unique_ptr<std::mutex> m_mutex{new std::mutex()};
 };
@@ -63,6 +63,12 @@ public:
   // returns the Thrift port if one was specified on the command line
   int get_runtime_port() { return thrift_port; }
 
+  // only set from the command line if has_threading_options() returns true
+  int get_nb_ingress_threads() const { return nb_ingress_threads; }
+  int get_nb_egress_threads() const { return nb_egress_threads; }
+  int get_nb_priority_queues() const { return nb_priority_queues; }
+  bool is_run_to_completion() const { return run_to_completion; }
+
 public:
   MatchErrorCode
   mt_add_entry(const std::string &table_name,
@@ -71,6 +77,12 @@ public:
 	       ActionData action_data,
 	       entry_handle_t *handle,
 	       int priority = -1/*only used for ternary*/) override;
+
+  MatchErrorCode
+  mt_add_entries(const std::string &table_name,
+		 std::vector<NewEntry> entries,
+		 std::vector<MatchErrorCode> *rcs,
+		 std::vector<entry_handle_t> *handles) override;
   
   MatchErrorCode
   mt_set_default_action(const std::string &table_name,
@@ -115,6 +127,12 @@ public:
 			entry_handle_t *handle,
 			int priority = 1) override;
 
+  MatchErrorCode
+  mt_indirect_add_entries(const std::string &table_name,
+			  const std::vector<IndirectNewEntry> &entries,
+			  std::vector<MatchErrorCode> *rcs,
+			  std::vector<entry_handle_t> *handles) override;
+
   MatchErrorCode
   mt_indirect_modify_entry(const std::string &table_name,
 			   entry_handle_t handle,
@@ -156,6 +174,12 @@ public:
 			   entry_handle_t *handle,
 			   int priority = 1) override;
 
+  MatchErrorCode
+  mt_indirect_ws_add_entries(const std::string &table_name,
+			     const std::vector<IndirectWSNewEntry> &entries,
+			     std::vector<MatchErrorCode> *rcs,
+			     std::vector<entry_handle_t> *handles) override;
+
   MatchErrorCode
   mt_indirect_ws_modify_entry(const std::string &table_name,
 			      entry_handle_t handle,
@@ -233,6 +257,15 @@ protected:
   // invalidate all pointers obtained with get_pipeline(), get_parser(),...
   int do_swap();
 
+  // called by init_from_command_line_options() before any port is added, so
+  // that the target can set itself up according to the options before it
+  // starts receiving packets
+  virtual void options_parsed() { }
+
+  // true if the target honors --ingress-threads, --egress-threads,
+  // --priority-queues and --run-to-completion; they are rejected otherwise
+  virtual bool has_threading_options() const { return false; }
+
   template<typename T>
   bool add_component(std::shared_ptr<T> ptr) {
     std::shared_ptr<void> ptr_ = std::static_pointer_cast<void>(ptr);
@@ -290,6 +323,11 @@ private:
   int thrift_port{};
 
   int device_id{};
+
+  int nb_ingress_threads{1};
+  int nb_egress_threads{1};
+  int nb_priority_queues{1};
+  bool run_to_completion{false};
 };
 
 #endif
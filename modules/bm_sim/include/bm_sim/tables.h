@@ -33,7 +33,7 @@ template<typename T>
 struct HasFactoryMethod
 {
   typedef std::unique_ptr<T> (*Signature)(
-    const std::string &, const std::string &,
+    const std::string &, const std::string &, const std::string &,
     p4object_id_t, size_t, const MatchKeyBuilder &,
     bool, bool
   );
@@ -60,7 +60,7 @@ public:
 public:
   template <typename MT>
   static std::unique_ptr<MatchActionTable> create_match_action_table(
-    const std::string &match_type,
+    const std::string &match_type, const std::string &match_algo,
     const std::string &name, p4object_id_t id,
     size_t size, const MatchKeyBuilder &match_key_builder,
     bool with_counters, bool with_ageing
@@ -72,7 +72,8 @@ public:
 		  "template class needs to have a create() static factory method");
 
     std::unique_ptr<MT> match_table = MT::create(
-      match_type, name, id, size, match_key_builder, with_counters, with_ageing
+      match_type, match_algo, name, id, size, match_key_builder,
+      with_counters, with_ageing
     );
 
     return std::unique_ptr<MatchActionTable>(
@@ -0,0 +1,178 @@
+/* Copyright 2013-present Barefoot Networks, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Antonin Bas (antonin@barefootnetworks.com)
+ *
+ */
+
+#ifndef _BM_TERNARY_CLASSIFIER_H_
+#define _BM_TERNARY_CLASSIFIER_H_
+
+#include <string>
+#include <vector>
+#include <set>
+#include <memory>
+#include <unordered_map>
+
+#include "bytecontainer.h"
+#include "exact_map.h"
+
+/* Index of the rules of a ternary table, which can be used instead of scanning
+   all of them. Keys are already masked when they are inserted. The rule with
+   the lowest priority value wins, and among rules with the same priority, the
+   one with the lowest handle wins, like for a scan of all the rules in handle
+   order. Lookups can run concurrently, updates cannot. */
+
+class TernaryClassifier {
+public:
+  typedef uintptr_t handle_t;
+
+public:
+  virtual ~TernaryClassifier() { }
+
+  virtual void insert(handle_t handle, const ByteContainer &key,
+		      const ByteContainer &mask, int priority) = 0;
+
+  virtual void remove(handle_t handle, const ByteContainer &key,
+		      const ByteContainer &mask, int priority) = 0;
+
+  virtual bool lookup(const ByteContainer &key, handle_t *handle) const = 0;
+
+  virtual void clear() = 0;
+
+  // the rules inserted in between may only be indexed by end_batch(), so no
+  // lookup or removal can happen before it
+  virtual void begin_batch() { }
+
+  virtual void end_batch() { }
+
+  // returns nullptr for "linear" (or an empty string), in which case the table
+  // scans all its rules
+  static std::unique_ptr<TernaryClassifier> create(const std::string &algo,
+						   size_t nbytes_key);
+
+protected:
+  // the best rule is the smallest one
+  struct Rule {
+    Rule(int priority, handle_t handle)
+      : priority(priority), handle(handle) { }
+
+    bool operator<(const Rule &other) const {
+      return (priority != other.priority) ?
+	(priority < other.priority) : (handle < other.handle);
+    }
+
+    int priority;
+    handle_t handle;
+  };
+};
+
+/* Tuple space search: the rules are partitioned by mask, and each partition (a
+   tuple) has a hash table of the masked keys. A lookup masks the key with the
+   mask of each tuple and looks it up, going through the tuples in order of
+   their best priority, so that it can stop as soon as no remaining tuple can
+   have a better rule than the one found. The number of distinct masks in an ACL
+   is usually small compared to the number of rules. */
+
+class TupleSpaceClassifier : public TernaryClassifier {
+public:
+  explicit TupleSpaceClassifier(size_t nbytes_key)
+    : nbytes_key(nbytes_key) { }
+
+  void insert(handle_t handle, const ByteContainer &key,
+	      const ByteContainer &mask, int priority) override;
+
+  void remove(handle_t handle, const ByteContainer &key,
+	      const ByteContainer &mask, int priority) override;
+
+  bool lookup(const ByteContainer &key, handle_t *handle) const override;
+
+  void clear() override;
+
+  void begin_batch() override { in_batch = true; }
+
+  void end_batch() override;
+
+  size_t get_num_tuples() const { return tuples.size(); }
+
+private:
+  struct Tuple {
+    Tuple(const ByteContainer &mask, size_t nbytes_key)
+      : mask(mask), index(nbytes_key) { }
+
+    ByteContainer mask;
+    // masked key -> position in buckets
+    ExactMap index;
+    // all the rules with the same masked key, best one first
+    std::vector<std::vector<Rule> > buckets{};
+    std::vector<size_t> free_buckets{};
+    std::multiset<int> priorities{};
+    int best_priority{0};
+  };
+
+  void sort_tuples();
+
+private:
+  size_t nbytes_key{0};
+  std::unordered_map<ByteContainer, std::unique_ptr<Tuple>,
+		     ByteContainerKeyHash> tuples{};
+  // best priority first
+  std::vector<const Tuple *> sorted_tuples{};
+  bool in_batch{false};
+};
+
+/* For small tables (a few hundred rules), a scan is hard to beat, as long as it
+   goes through contiguous memory and can stop at the first hit. The rules are
+   kept sorted by priority (then handle), and each one is a row of 64-bit words,
+   its key followed by its mask. Rows are padded to a whole number of SIMD
+   registers (with a mask of 0, which matches anything) and compared a register
+   at a time with AVX2 or SSE2 when available. */
+
+class PackedScanClassifier : public TernaryClassifier {
+public:
+  explicit PackedScanClassifier(size_t nbytes_key);
+
+  void insert(handle_t handle, const ByteContainer &key,
+	      const ByteContainer &mask, int priority) override;
+
+  void remove(handle_t handle, const ByteContainer &key,
+	      const ByteContainer &mask, int priority) override;
+
+  bool lookup(const ByteContainer &key, handle_t *handle) const override;
+
+  void clear() override;
+
+  void begin_batch() override { in_batch = true; }
+
+  void end_batch() override;
+
+private:
+  void pack(const ByteContainer &bytes, uint64_t *words) const;
+
+  bool match_row(const uint64_t *key, const uint64_t *row) const;
+
+private:
+  size_t nbytes_key{0};
+  size_t nwords{0};
+  // in the same order as the rows
+  std::vector<Rule> rules{};
+  // one row of 2 * nwords words per rule
+  std::vector<uint64_t> rows{};
+  // rules are appended, and only sorted by end_batch()
+  bool in_batch{false};
+};
+
+#endif
@@ -0,0 +1,65 @@
+/* Copyright 2013-present Barefoot Networks, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Antonin Bas (antonin@barefootnetworks.com)
+ *
+ */
+
+#ifndef _BM_THREAD_AFFINITY_H_
+#define _BM_THREAD_AFFINITY_H_
+
+#include <vector>
+#include <string>
+#include <functional>
+
+#include <pthread.h>
+
+// The CPUs each kind of thread is pinned to, as given on the command line.
+// Threads of a pool (ingress, egress) are each pinned to one CPU of the list,
+// in turn; the other threads can run on any CPU of their list. Nothing is
+// pinned for a role without CPUs.
+//
+// Memory is placed by the kernel on the NUMA node of the thread which first
+// touches it, so data meant for a pinned thread should be allocated and
+// initialized by that thread, or with run_pinned().
+class ThreadAffinity {
+public:
+  enum class Role { INGRESS, EGRESS, TRANSMIT, RX, THRIFT };
+
+  // -1 for the whole list, otherwise the index of the thread in its pool
+  static const int ANY = -1;
+
+public:
+  // parses a list like "0-3,8,10-11", returns false if it is not valid
+  static bool parse_cpu_list(const std::string &str, std::vector<int> *cpus);
+
+  static void set_cpus(Role role, const std::vector<int> &cpus);
+
+  static bool has_cpus(Role role);
+
+  static void pin_thread(pthread_t thread, Role role, int index = ANY);
+
+  static void pin_current_thread(Role role, int index = ANY) {
+    pin_thread(pthread_self(), role, index);
+  }
+
+  // runs fn to completion on a thread pinned like thread index of role, so
+  // that the memory it touches first ends up on the right NUMA node; simply
+  // calls fn if role has no CPUs
+  static void run_pinned(Role role, int index, const std::function<void()> &fn);
+};
+
+#endif
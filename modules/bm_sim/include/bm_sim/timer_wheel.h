@@ -0,0 +1,183 @@
+/* Copyright 2013-present Barefoot Networks, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Antonin Bas (antonin@barefootnetworks.com)
+ *
+ */
+
+#ifndef _BM_TIMER_WHEEL_H_
+#define _BM_TIMER_WHEEL_H_
+
+#include <chrono>
+#include <vector>
+#include <utility>
+
+#include <cstdint>
+
+/* Hierarchical timer wheel, with 4 levels of 256 slots. Time is counted in
+   ticks, whose duration is given to the constructor. A timer goes to the level
+   of the highest base-256 digit in which its expiry differs from the current
+   tick, in the slot given by that digit; when the wheel reaches that slot, the
+   timer is moved down to a lower level. Timers more than 2^32 ticks away wait
+   in an overflow list. Expiries are rounded up to the next tick, so a timer
+   never fires early. Timers cannot be cancelled, and the wheel is not
+   thread-safe. */
+
+template <typename T>
+class TimerWheel {
+public:
+  typedef std::chrono::high_resolution_clock clock;
+
+public:
+  explicit TimerWheel(clock::duration tick,
+		      clock::time_point origin = clock::now())
+    : tick(tick), origin(origin) { }
+
+  void schedule(clock::time_point when, T item) {
+    insert(Timer(to_tick_ceil(when), std::move(item)));
+  }
+
+  // calls fire(item) for every timer which has expired by now; fire can
+  // schedule new timers
+  template <typename F>
+  void advance(clock::time_point now, F fire) {
+    const uint64_t target = to_tick_floor(now);
+    while(current < target) {
+      uint64_t next = current + 1;
+      if(counts[0] == 0) {
+	// nothing can happen before the next slot of the first non-empty level
+	int level = 1;
+	while(level < nb_levels && counts[level] == 0) level++;
+	next = (current | span_mask(level)) + 1;
+	if(next > target) {
+	  current = target;
+	  break;
+	}
+      }
+      current = next;
+      if((current & span_mask(nb_levels)) == 0) cascade(&overflow, nb_levels);
+      for(int level = nb_levels - 1; level > 0; level--) {
+	if((current & span_mask(level)) == 0)
+	  cascade(&slots[level][digit(current, level)], level);
+      }
+      cascade(&slots[0][digit(current, 0)], 0);
+    }
+
+    std::vector<Timer> expired;
+    expired.swap(due);
+    for(auto &timer : expired) fire(timer.item);
+  }
+
+  // may be earlier than the actual expiry of the first timer when it has not
+  // been moved down to level 0 yet; clock::time_point::max() if no timer
+  clock::time_point next_expiry() const {
+    if(!due.empty()) return to_time(current);
+    for(int level = 0; level < nb_levels; level++) {
+      if(counts[level] == 0) continue;
+      for(size_t s = digit(current, level) + 1; s < nb_slots; s++) {
+	if(slots[level][s].empty()) continue;
+	uint64_t base = current & ~span_mask(level + 1);
+	return to_time(base | (static_cast<uint64_t>(s) << (slot_bits * level)));
+      }
+    }
+    if(counts[nb_levels] > 0)
+      return to_time((current | span_mask(nb_levels)) + 1);
+    return clock::time_point::max();
+  }
+
+  size_t size() const {
+    size_t n = due.size();
+    for(size_t count : counts) n += count;
+    return n;
+  }
+
+  bool empty() const { return size() == 0; }
+
+  TimerWheel(const TimerWheel &) = delete;
+  TimerWheel &operator =(const TimerWheel &) = delete;
+
+private:
+  static const int nb_levels = 4;
+  static const int slot_bits = 8;
+  static const size_t nb_slots = 1 << slot_bits;
+
+  struct Timer {
+    Timer(uint64_t expiry, T item)
+      : expiry(expiry), item(std::move(item)) { }
+
+    uint64_t expiry;
+    T item;
+  };
+
+  static uint64_t span_mask(int level) {
+    return (static_cast<uint64_t>(1) << (slot_bits * level)) - 1;
+  }
+
+  static size_t digit(uint64_t t, int level) {
+    return (t >> (slot_bits * level)) & (nb_slots - 1);
+  }
+
+  uint64_t to_tick_floor(clock::time_point t) const {
+    if(t <= origin) return 0;
+    return (t - origin) / tick;
+  }
+
+  uint64_t to_tick_ceil(clock::time_point t) const {
+    if(t <= origin) return 0;
+    auto d = t - origin;
+    return d / tick + ((d % tick) != clock::duration::zero());
+  }
+
+  clock::time_point to_time(uint64_t t) const {
+    return origin + tick * static_cast<clock::rep>(t);
+  }
+
+  void insert(Timer &&timer) {
+    if(timer.expiry <= current) {
+      due.push_back(std::move(timer));
+      return;
+    }
+    uint64_t diff = timer.expiry ^ current;
+    int level = 0;
+    while(level < nb_levels && (diff >> (slot_bits * (level + 1))) != 0)
+      level++;
+    counts[level]++;
+    if(level == nb_levels)
+      overflow.push_back(std::move(timer));
+    else
+      slots[level][digit(timer.expiry, level)].push_back(std::move(timer));
+  }
+
+  void cascade(std::vector<Timer> *slot, int level) {
+    if(slot->empty()) return;
+    std::vector<Timer> timers;
+    timers.swap(*slot);
+    counts[level] -= timers.size();
+    for(auto &timer : timers) insert(std::move(timer));
+  }
+
+private:
+  clock::duration tick;
+  clock::time_point origin;
+  uint64_t current{0};
+  std::vector<Timer> slots[nb_levels][nb_slots];
+  std::vector<Timer> overflow{};
+  // number of timers in each level, the last one is the overflow list
+  size_t counts[nb_levels + 1]{};
+  std::vector<Timer> due{};
+};
+
+#endif
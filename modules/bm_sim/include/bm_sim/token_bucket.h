@@ -0,0 +1,133 @@
+/* Copyright 2013-present Barefoot Networks, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Antonin Bas (antonin@barefootnetworks.com)
+ *
+ */
+
+#ifndef _BM_TOKEN_BUCKET_H_
+#define _BM_TOKEN_BUCKET_H_
+
+#include <chrono>
+#include <algorithm>
+
+#include <cstdint>
+#include <cmath>
+
+/* Token bucket, in packets or in bytes. Rather than a token count, we keep the
+   time at which the bucket will be full again (GCRA), so that nothing needs to
+   be refilled periodically and the departure time of the next packet is known
+   right away. The size of a packet does not need to be known before it is
+   dequeued: a packet can leave as soon as there is one token, and the bucket
+   goes into debt if the packet is bigger than what was available. Nothing
+   blocks, and it is not thread-safe, including set_rate(). */
+
+class TokenBucket {
+public:
+  typedef std::chrono::high_resolution_clock clock;
+
+public:
+  // rate is in units (packets or bytes) per second, 0 disables the bucket;
+  // burst is the number of units the bucket can hold; the debt accumulated at
+  // the old rate is forgiven, otherwise it would keep applying at the new one
+  void set_rate(uint64_t new_rate, uint64_t burst,
+		clock::time_point now = clock::now()) {
+    rate = new_rate;
+    full_at = std::min(full_at, now);
+    carry_ns = 0;
+    if(rate == 0) return;
+    burst = std::max<uint64_t>(burst, 1);
+    interval_ns = 1e9 / rate;
+    tolerance = std::chrono::duration_cast<clock::duration>(
+      std::chrono::duration<double, std::nano>((burst - 1) * interval_ns)
+    );
+  }
+
+  bool is_enabled() const { return rate != 0; }
+
+  uint64_t get_rate() const { return rate; }
+
+  // the time from which there is a token available, possibly in the past
+  clock::time_point next_departure() const {
+    if(rate == 0) return clock::time_point::min();
+    return full_at - tolerance;
+  }
+
+  bool ready(clock::time_point now) const {
+    return now >= next_departure();
+  }
+
+  void consume(clock::time_point now, uint64_t units) {
+    if(rate == 0) return;
+    // the bucket cannot hold more than burst units
+    full_at = std::max(full_at, now);
+    // the fractional nanoseconds are carried over to the next call
+    double ns = units * interval_ns + carry_ns;
+    double whole_ns = std::floor(ns);
+    carry_ns = ns - whole_ns;
+    full_at += std::chrono::duration_cast<clock::duration>(
+      std::chrono::nanoseconds(static_cast<int64_t>(whole_ns))
+    );
+  }
+
+private:
+  uint64_t rate{0};
+  double interval_ns{0};
+  double carry_ns{0};
+  clock::duration tolerance{clock::duration::zero()};
+  clock::time_point full_at{};
+};
+
+/* A packet rate and a byte rate, a packet can leave only when both allow it */
+
+class Shaper {
+public:
+  typedef TokenBucket::clock clock;
+
+public:
+  void set_packet_rate(uint64_t pps, uint64_t burst_pkts = 1,
+		       clock::time_point now = clock::now()) {
+    packets.set_rate(pps, burst_pkts, now);
+  }
+
+  void set_byte_rate(uint64_t bytes_per_sec, uint64_t burst_bytes,
+		     clock::time_point now = clock::now()) {
+    bytes.set_rate(bytes_per_sec, burst_bytes, now);
+  }
+
+  bool is_enabled() const {
+    return packets.is_enabled() || bytes.is_enabled();
+  }
+
+  clock::time_point next_departure() const {
+    return std::max(packets.next_departure(), bytes.next_departure());
+  }
+
+  bool ready(clock::time_point now) const {
+    return packets.ready(now) && bytes.ready(now);
+  }
+
+  void consume(clock::time_point now, uint64_t nb_bytes) {
+    packets.consume(now, 1);
+    bytes.consume(now, nb_bytes);
+  }
+
+private:
+  TokenBucket packets{};
+  TokenBucket bytes{};
+};
+
+#endif
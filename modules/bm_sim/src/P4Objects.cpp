@@ -538,25 +538,31 @@ int P4Objects::init_objects(std::istream &is,
 	cfg_table.get("with_counters", false_value).asBool();
       const bool with_ageing =
 	cfg_table.get("support_timeout", false_value).asBool();
+      // optional, the algorithm used to match ternary tables (see
+      // TernaryClassifier::create) or LPM tables (see MatchUnitLPM), empty for
+      // the default one
+      const Json::Value default_algo("");
+      const string match_algo =
+	cfg_table.get("match_algo", default_algo).asString();
 
       // TODO: improve this to make it easier to create new kind of tables
       // e.g. like the register mechanism for primitives :)
       std::unique_ptr<MatchActionTable> table;
       if(table_type == "simple") {
 	table = MatchActionTable::create_match_action_table<MatchTable>(
-          match_type, table_name, table_id, table_size, key_builder,
+          match_type, match_algo, table_name, table_id, table_size, key_builder,
 	  with_counters, with_ageing
         );
       }
       else if(table_type == "indirect") {
 	table = MatchActionTable::create_match_action_table<MatchTableIndirect>(
-          match_type, table_name, table_id, table_size, key_builder,
+          match_type, match_algo, table_name, table_id, table_size, key_builder,
 	  with_counters, with_ageing
         );
       }
       else if(table_type == "indirect_ws") {
 	table = MatchActionTable::create_match_action_table<MatchTableIndirectWS>(
-          match_type, table_name, table_id, table_size, key_builder,
+          match_type, match_algo, table_name, table_id, table_size, key_builder,
 	  with_counters, with_ageing
         );
 
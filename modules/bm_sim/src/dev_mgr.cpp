@@ -30,6 +30,13 @@ DevMgr::~DevMgr() {
   bmi_port_destroy_mgr(port_mgr);
 }
 
+pthread_t
+DevMgr::get_rx_thread() const {
+  pthread_t thread;
+  assert(!bmi_port_get_select_thread(port_mgr, &thread));
+  return thread;
+}
+
 DevMgr::ReturnCode
 DevMgr::port_add(const std::string &iface_name, port_t port_num,
 		 const char *pcap)
@@ -57,6 +57,7 @@ static inline void fill_msg_hdr(EventType type, const Packet &packet,
 }
 
 void EventLogger::packet_in(const Packet &packet) {
+  if(!enabled) return;
   typedef struct : msg_hdr_t {
     int port_in;
   } __attribute__((packed)) msg_t;
@@ -68,6 +69,7 @@ void EventLogger::packet_in(const Packet &packet) {
 };
 
 void EventLogger::packet_out(const Packet &packet) {
+  if(!enabled) return;
   typedef struct : msg_hdr_t {
     int port_out;
   } __attribute__((packed)) msg_t;
@@ -80,6 +82,7 @@ void EventLogger::packet_out(const Packet &packet) {
 
 void EventLogger::parser_start(const Packet &packet, 
 			       const Parser &parser) {
+  if(!enabled) return;
   typedef struct : msg_hdr_t {
     int parser_id;
   } __attribute__((packed)) msg_t;
@@ -92,6 +95,7 @@ void EventLogger::parser_start(const Packet &packet,
 
 void EventLogger::parser_done(const Packet &packet,
 			      const Parser &parser) {
+  if(!enabled) return;
   typedef struct : msg_hdr_t {
     int parser_id;
   } __attribute__((packed)) msg_t;
@@ -104,6 +108,7 @@ void EventLogger::parser_done(const Packet &packet,
 
 void EventLogger::parser_extract(const Packet &packet,
 				 header_id_t header) {
+  if(!enabled) return;
   typedef struct : msg_hdr_t {
     int header_id;
   } __attribute__((packed)) msg_t;
@@ -116,6 +121,7 @@ void EventLogger::parser_extract(const Packet &packet,
 
 void EventLogger::deparser_start(const Packet &packet,
 				 const Deparser &deparser) {
+  if(!enabled) return;
   typedef struct : msg_hdr_t {
     int deparser_id;
   } __attribute__((packed)) msg_t;
@@ -128,6 +134,7 @@ void EventLogger::deparser_start(const Packet &packet,
 
 void EventLogger::deparser_done(const Packet &packet,
 				const Deparser &deparser) {
+  if(!enabled) return;
   typedef struct : msg_hdr_t {
     int deparser_id;
   } __attribute__((packed)) msg_t;
@@ -140,6 +147,7 @@ void EventLogger::deparser_done(const Packet &packet,
 
 void EventLogger::deparser_emit(const Packet &packet,
 				header_id_t header) {
+  if(!enabled) return;
   typedef struct : msg_hdr_t {
     int header_id;
   } __attribute__((packed)) msg_t;
@@ -152,6 +160,7 @@ void EventLogger::deparser_emit(const Packet &packet,
 
 void EventLogger::checksum_update(const Packet &packet,
 				  const Checksum &checksum) {
+  if(!enabled) return;
   typedef struct : msg_hdr_t {
     int checksum_id;
   } __attribute__((packed)) msg_t;
@@ -164,6 +173,7 @@ void EventLogger::checksum_update(const Packet &packet,
 
 void EventLogger::pipeline_start(const Packet &packet,
 				 const Pipeline &pipeline) {
+  if(!enabled) return;
   typedef struct : msg_hdr_t {
     int pipeline_id;
   } __attribute__((packed)) msg_t;
@@ -176,6 +186,7 @@ void EventLogger::pipeline_start(const Packet &packet,
 
 void EventLogger::pipeline_done(const Packet &packet,
 				const Pipeline &pipeline) {
+  if(!enabled) return;
   typedef struct : msg_hdr_t {
     int pipeline_id;
   } __attribute__((packed)) msg_t;
@@ -188,6 +199,7 @@ void EventLogger::pipeline_done(const Packet &packet,
 
 void EventLogger::condition_eval(const Packet &packet,
 				 const Conditional &cond, bool result) {
+  if(!enabled) return;
   typedef struct : msg_hdr_t {
     int condition_id;
     int result;  // 0 (true) or 1 (false);
@@ -213,6 +225,7 @@ void EventLogger::condition_eval(const Packet &packet,
 void EventLogger::table_hit(const Packet &packet,
 			    const MatchTableAbstract &table,
 			    entry_handle_t handle) {
+  if(!enabled) return;
   typedef struct : msg_hdr_t {
     int table_id;
     int entry_hdl;
@@ -227,6 +240,7 @@ void EventLogger::table_hit(const Packet &packet,
 
 void EventLogger::table_miss(const Packet &packet,
 			     const MatchTableAbstract &table) {
+  if(!enabled) return;
   typedef struct : msg_hdr_t {
     int table_id;
   } __attribute__((packed)) msg_t;
@@ -240,6 +254,7 @@ void EventLogger::table_miss(const Packet &packet,
 void EventLogger::action_execute(const Packet &packet,
 				 const ActionFn &action_fn,
 				 const ActionData &action_data) {
+  if(!enabled) return;
   typedef struct : msg_hdr_t {
     int action_id;
   } __attribute__((packed)) msg_t;
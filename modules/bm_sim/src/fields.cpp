@@ -25,7 +25,7 @@
 int Field::extract(const char *data, int hdr_offset) {
   if(hdr_offset == 0 && nbits % 8 == 0) {
     std::copy(data, data + nbytes, bytes.begin());
-    if(arith) sync_value();
+    bytes_updated();
     return nbits;
   }
 
@@ -59,12 +59,14 @@ int Field::extract(const char *data, int hdr_offset) {
     }
   }
 
-  if(arith) sync_value();
+  bytes_updated();
 
   return nbits;
 }
 
 int Field::deparse(char *data, int hdr_offset) const {
+  if(bytes_dirty) sync_bytes();
+
   if(hdr_offset == 0 && nbits % 8 == 0) {
     std::copy(bytes.begin(), bytes.end(), data);
     return nbits;
@@ -18,49 +18,62 @@
  *
  */
 
+#include <algorithm>
+
 #include "bm_sim/headers.h"
 
 Header::Header(const std::string &name, p4object_id_t id,
-	       const HeaderType &header_type,
-	       const std::set<int> &arith_offsets,
-	       const bool metadata)
-  : NamedP4Object(name, id), header_type(header_type), metadata(metadata) {
+	       const HeaderType &header_type, Field *fields,
+	       const PHVGenerations &generations, const bool metadata)
+  : NamedP4Object(name, id), header_type(header_type), fields(fields),
+    num_fields(header_type.get_num_fields()), generations(&generations),
+    reset_generation(generations.metadata), metadata(metadata) {
   // header_type_id = header_type.get_type_id();
-  for(int i = 0; i < header_type.get_num_fields(); i++) {
-    // use emplace_back instead?
-    bool arith_flag = true;
-    if(arith_offsets.find(i) == arith_offsets.end()) {
-      arith_flag = false;
-    }
-    fields.push_back(Field(header_type.get_bit_width(i), arith_flag));
-    nbytes_phv += fields.back().get_nbytes();
-    nbytes_packet += fields.back().get_nbits();
+  for(const Field &f : *this) {
+    nbytes_phv += f.get_nbytes();
+    nbytes_packet += f.get_nbits();
   }
   assert(nbytes_packet % 8 == 0);
   nbytes_packet /= 8;
 }
 
 void Header::extract(const char *data) {
-  int hdr_offset = 0;
-  for(std::vector<Field>::iterator it = fields.begin();
-      it != fields.end();
-      ++it) {
-    hdr_offset += it->extract(data, hdr_offset);
-    data += hdr_offset / 8;
-    hdr_offset = hdr_offset % 8;
+  // all the fields are overwritten, no need to copy them first
+  cow_src = nullptr;
+  for(const HeaderType::PlanStep &step : header_type.get_plan()) {
+    const char *src = data + step.byte_offset;
+    if(step.type == HeaderType::PlanStep::Type::COPY) {
+      for(int i = step.field_begin; i < step.field_end; i++) {
+	Field &f = fields[i];
+	f.set_bytes(src, f.get_nbytes());
+	src += f.get_nbytes();
+      }
+    }
+    else {
+      fields[step.field_begin].extract(src, step.bit_offset);
+    }
   }
+  // all the fields have been overwritten
+  reset_generation = generations->metadata;
   mark_valid();
   return;
 }
 
 void Header::deparse(char *data) const {
-  int hdr_offset = 0;
-  for(std::vector<Field>::const_iterator it = fields.begin();
-      it != fields.end();
-      ++it) {
-    hdr_offset += it->deparse(data, hdr_offset);
-    data += hdr_offset / 8;
-    hdr_offset = hdr_offset % 8;
+  refresh();
+  const Field *fields = get_fields();
+  for(const HeaderType::PlanStep &step : header_type.get_plan()) {
+    char *dst = data + step.byte_offset;
+    if(step.type == HeaderType::PlanStep::Type::COPY) {
+      for(int i = step.field_begin; i < step.field_end; i++) {
+	const ByteContainer &bytes = fields[i].get_bytes();
+	std::copy(bytes.begin(), bytes.end(), dst);
+	dst += bytes.size();
+      }
+    }
+    else {
+      fields[step.field_begin].deparse(dst, step.bit_offset);
+    }
   }
   return;
 }
@@ -0,0 +1,231 @@
+/* Copyright 2013-present Barefoot Networks, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Antonin Bas (antonin@barefootnetworks.com)
+ *
+ */
+
+#include <algorithm>
+
+#include <cassert>
+
+#include "bm_sim/lpm_dir24_8.h"
+
+namespace {
+
+uint32_t get_value(const char *bytes) {
+  const unsigned char *b = reinterpret_cast<const unsigned char *>(bytes);
+  return (static_cast<uint32_t>(b[0]) << 24) | (b[1] << 16) | (b[2] << 8) | b[3];
+}
+
+}
+
+LPMDir24_8::LPMDir24_8(size_t key_width_bytes)
+  : key_width_bytes(key_width_bytes), nb_valid(key_width_bytes - 4)
+{
+  assert(key_width_bytes >= 4 && nb_valid <= max_valid_bytes);
+  tables24.resize(1 << nb_valid);
+  prefixes.resize(key_width_bytes * 8 + 1);
+}
+
+std::string
+LPMDir24_8::masked_key(const char *bytes, int prefix_length) const
+{
+  std::string key(bytes, key_width_bytes);
+  for(size_t i = 0; i < key_width_bytes; i++) {
+    int bits = std::min(std::max(prefix_length - static_cast<int>(i * 8), 0), 8);
+    key[i] &= static_cast<char>(0xff00 >> bits);
+  }
+  return key;
+}
+
+// the prefix with its valid bytes replaced by the given combination
+std::string
+LPMDir24_8::combination_key(size_t combination,
+			    const std::string &prefix) const
+{
+  std::string key(prefix);
+  for(size_t i = 0; i < nb_valid; i++)
+    key[i] = (combination >> (nb_valid - 1 - i)) & 1;
+  return key;
+}
+
+// the entry of the longest prefix of key shorter than max_length
+uint32_t
+LPMDir24_8::best_entry(const std::string &key, int max_length) const
+{
+  for(int length = max_length - 1; length >= 0; length--) {
+    const auto &map = prefixes[length];
+    if(map.empty()) continue;
+    auto it = map.find(masked_key(key.data(), length));
+    if(it != map.end()) return make_entry(length, it->second);
+  }
+  return 0;
+}
+
+uint32_t
+LPMDir24_8::new_group(uint32_t entry)
+{
+  uint32_t group;
+  if(!free_groups.empty()) {
+    group = free_groups.back();
+    free_groups.pop_back();
+  }
+  else {
+    group = group_prefixes.size();
+    group_prefixes.push_back(0);
+    tables8.resize(tables8.size() + 256);
+  }
+  std::fill(tables8.begin() + group * 256, tables8.begin() + (group + 1) * 256,
+	    entry);
+  return group;
+}
+
+// writes entry to all the entries covered by value/value_length which belong
+// to prefixes no longer than prefix_length (when inserting) or to the prefix of
+// length prefix_length (when deleting)
+void
+LPMDir24_8::set_range(size_t combination, uint32_t value, int value_length,
+		      int prefix_length, uint32_t entry, bool insert)
+{
+  auto update = [prefix_length, entry, insert](uint32_t *e) {
+    int length = entry_length(*e);
+    if(insert ? (length <= prefix_length) :
+       (length == prefix_length && *e != 0))
+      *e = entry;
+  };
+
+  std::vector<uint32_t> &table24 = tables24[combination];
+  if(table24.empty()) {
+    if(!insert) return;
+    table24.assign(1 << 24, 0);
+  }
+
+  if(value_length <= 24) {
+    uint32_t first = value >> 8;
+    uint32_t last = first + (1u << (24 - value_length));
+    for(uint32_t i = first; i < last; i++) {
+      uint32_t &e = table24[i];
+      if(e & group_flag) {
+	uint32_t *group = &tables8[(e & ~group_flag) * 256];
+	for(int j = 0; j < 256; j++) update(&group[j]);
+      }
+      else {
+	update(&e);
+      }
+    }
+    return;
+  }
+
+  uint32_t &e = table24[value >> 8];
+  if(!(e & group_flag)) {
+    assert(insert);
+    e = group_flag | new_group(e);
+  }
+  uint32_t group = e & ~group_flag;
+  uint32_t first = value & 0xff;
+  uint32_t last = first + (1u << (32 - value_length));
+  for(uint32_t j = first; j < last; j++) update(&tables8[group * 256 + j]);
+
+  if(insert) {
+    group_prefixes[group]++;
+  }
+  else if(--group_prefixes[group] == 0) {
+    // all the entries of the group are the same again
+    e = tables8[group * 256];
+    free_groups.push_back(group);
+  }
+}
+
+void
+LPMDir24_8::insert_prefix(const ByteContainer &prefix, int prefix_length,
+			  uintptr_t value)
+{
+  assert(value < max_value);
+  if(has_prefix(prefix, prefix_length)) delete_prefix(prefix, prefix_length);
+
+  const std::string key = masked_key(prefix.data(), prefix_length);
+  prefixes[prefix_length][key] = value;
+
+  const int valid_length = nb_valid * 8;
+  const uint32_t entry = make_entry(prefix_length, value);
+  for(size_t c = 0; c < tables24.size(); c++) {
+    // skip the combinations of valid bytes which the prefix does not cover
+    if(masked_key(combination_key(c, key).data(), prefix_length) != key)
+      continue;
+    set_range(c, get_value(&key[nb_valid]),
+	      std::max(prefix_length - valid_length, 0), prefix_length, entry,
+	      true);
+  }
+}
+
+bool
+LPMDir24_8::delete_prefix(const ByteContainer &prefix, int prefix_length)
+{
+  const std::string key = masked_key(prefix.data(), prefix_length);
+  auto &map = prefixes[prefix_length];
+  auto it = map.find(key);
+  if(it == map.end()) return false;
+  map.erase(it);
+
+  const int valid_length = nb_valid * 8;
+  for(size_t c = 0; c < tables24.size(); c++) {
+    const std::string c_key = combination_key(c, key);
+    if(masked_key(c_key.data(), prefix_length) != key) continue;
+    // the entries go back to the longest prefix covering this one
+    set_range(c, get_value(&key[nb_valid]),
+	      std::max(prefix_length - valid_length, 0), prefix_length,
+	      best_entry(c_key, prefix_length), false);
+  }
+  return true;
+}
+
+bool
+LPMDir24_8::has_prefix(const ByteContainer &prefix, int prefix_length) const
+{
+  const auto &map = prefixes[prefix_length];
+  return map.find(masked_key(prefix.data(), prefix_length)) != map.end();
+}
+
+bool
+LPMDir24_8::lookup(const ByteContainer &key, uintptr_t *value) const
+{
+  size_t combination = 0;
+  for(size_t i = 0; i < nb_valid; i++) {
+    // valid bytes are always 0 or 1 in the keys built for packets
+    if(static_cast<unsigned char>(key[i]) > 1) return false;
+    combination = (combination << 1) | key[i];
+  }
+  const std::vector<uint32_t> &table24 = tables24[combination];
+  if(table24.empty()) return false;
+
+  uint32_t v = get_value(&key[nb_valid]);
+  uint32_t e = table24[v >> 8];
+  if(e & group_flag) e = tables8[(e & ~group_flag) * 256 + (v & 0xff)];
+  if(e == 0) return false;
+  *value = (e & value_mask) - 1;
+  return true;
+}
+
+void
+LPMDir24_8::clear()
+{
+  for(auto &table24 : tables24) std::vector<uint32_t>().swap(table24);
+  std::vector<uint32_t>().swap(tables8);
+  group_prefixes.clear();
+  free_groups.clear();
+  for(auto &map : prefixes) map.clear();
+}
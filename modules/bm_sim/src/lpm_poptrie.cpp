@@ -0,0 +1,454 @@
+/* Copyright 2013-present Barefoot Networks, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Antonin Bas (antonin@barefootnetworks.com)
+ *
+ */
+
+#include <algorithm>
+
+#include <cassert>
+
+#include "bm_sim/lpm_poptrie.h"
+
+namespace {
+
+// bits 0 to n of the 64-bit bitmaps
+inline uint64_t bits_up_to(uint32_t n) {
+  // no overflow for n == 63, 2 << 63 is 0 for unsigned integers
+  return (2ULL << n) - 1;
+}
+
+inline int popcount(uint64_t bits) {
+  return __builtin_popcountll(bits);
+}
+
+}
+
+LPMPoptrie::LPMPoptrie(size_t key_width_bytes)
+  : key_width_bytes(key_width_bytes)
+{
+  assert(key_width_bytes * 8 >= static_cast<size_t>(top_bits));
+}
+
+// the top table takes a few MB, so it is only allocated on first insert
+void
+LPMPoptrie::allocate_top()
+{
+  if(!top.empty()) return;
+  top.resize(1 << top_bits);
+  top_leaf.resize(1 << top_bits);
+  top_length.resize(1 << top_bits);
+}
+
+// the bits of the key past its end are 0
+uint32_t
+LPMPoptrie::get_bits(const char *key, int offset, int nbits) const
+{
+  const unsigned char *bytes = reinterpret_cast<const unsigned char *>(key);
+  size_t byte = offset / 8;
+  uint32_t word = 0;
+  for(size_t i = byte; i < byte + 3; i++)
+    word = (word << 8) | ((i < key_width_bytes) ? bytes[i] : 0);
+  return (word >> (24 - offset % 8 - nbits)) & ((1u << nbits) - 1);
+}
+
+std::string
+LPMPoptrie::masked_key(const char *bytes, int prefix_length) const
+{
+  std::string key(bytes, key_width_bytes);
+  for(size_t i = 0; i < key_width_bytes; i++) {
+    int bits = std::min(std::max(prefix_length - static_cast<int>(i * 8), 0), 8);
+    key[i] &= static_cast<char>(0xff00 >> bits);
+  }
+  return key;
+}
+
+// sets the leaf of the entries of the top table covered by the prefix (at most
+// top_bits long) which belong to shorter prefixes (when inserting) or to the
+// prefix itself (when deleting), and rebuilds the nodes below them
+void
+LPMPoptrie::set_top_range(const std::string &prefix, int prefix_length,
+			  uint32_t leaf, int leaf_length, bool insert)
+{
+  uint32_t first = get_bits(prefix.data(), 0, top_bits);
+  uint32_t last = first + (1u << (top_bits - prefix_length));
+  for(uint32_t t = first; t < last; t++) {
+    if(insert ? (top_leaf[t] != 0 && top_length[t] > prefix_length) :
+       (top_leaf[t] == 0 || top_length[t] != prefix_length))
+      continue;
+    top_leaf[t] = leaf;
+    top_length[t] = leaf_length;
+    if(top[t] & node_flag)
+      rebuild(t);
+    else
+      top[t] = leaf;
+  }
+}
+
+void
+LPMPoptrie::insert_prefix(const ByteContainer &prefix, int prefix_length,
+			  uintptr_t value)
+{
+  assert(value < max_value);
+  allocate_top();
+  const std::string key = masked_key(prefix.data(), prefix_length);
+  rib[std::make_pair(key, prefix_length)] = value;
+  if(in_batch) return;
+  if(prefix_length <= top_bits)
+    set_top_range(key, prefix_length, value + 1, prefix_length, true);
+  else
+    rebuild_path(key, prefix_length);
+}
+
+bool
+LPMPoptrie::delete_prefix(const ByteContainer &prefix, int prefix_length)
+{
+  const std::string key = masked_key(prefix.data(), prefix_length);
+  auto it = rib.find(std::make_pair(key, prefix_length));
+  if(it == rib.end()) return false;
+  rib.erase(it);
+  if(in_batch) return true;
+
+  if(prefix_length > top_bits) {
+    rebuild_path(key, prefix_length);
+    return true;
+  }
+
+  // the entries go back to the longest prefix covering this one
+  uint32_t leaf = 0;
+  int leaf_length = 0;
+  for(int length = prefix_length - 1; length >= 0; length--) {
+    auto parent = rib.find(
+      std::make_pair(masked_key(key.data(), length), length)
+    );
+    if(parent != rib.end()) {
+      leaf = parent->second + 1;
+      leaf_length = length;
+      break;
+    }
+  }
+  set_top_range(key, prefix_length, leaf, leaf_length, false);
+  return true;
+}
+
+bool
+LPMPoptrie::has_prefix(const ByteContainer &prefix, int prefix_length) const
+{
+  return rib.find(
+    std::make_pair(masked_key(prefix.data(), prefix_length), prefix_length)
+  ) != rib.end();
+}
+
+bool
+LPMPoptrie::lookup(const ByteContainer &key, uintptr_t *value) const
+{
+  if(top.empty()) return false;
+  const char *bytes = key.data();
+  uint32_t leaf = top[get_bits(bytes, 0, top_bits)];
+  if(leaf & node_flag) {
+    const Node *node = &nodes[leaf & ~node_flag];
+    for(int offset = top_bits; ; offset += stride) {
+      uint32_t v = get_bits(bytes, offset, stride);
+      if(node->vector & (1ULL << v)) {
+	node = &nodes[node->base1 + popcount(node->vector & bits_up_to(v)) - 1];
+      }
+      else {
+	leaf = leaves[node->base0 + popcount(node->leafvec & bits_up_to(v)) - 1];
+	break;
+      }
+    }
+  }
+  if(leaf == 0) return false;
+  *value = leaf - 1;
+  return true;
+}
+
+void
+LPMPoptrie::clear()
+{
+  rib.clear();
+  std::vector<uint32_t>().swap(top);
+  std::vector<uint32_t>().swap(top_leaf);
+  std::vector<uint8_t>().swap(top_length);
+  std::vector<Node>().swap(nodes);
+  std::vector<uint32_t>().swap(leaves);
+  garbage_nodes = 0;
+  garbage_leaves = 0;
+}
+
+// true if the first nbits bits of key and prefix are the same
+bool
+LPMPoptrie::same_bits(const std::string &key, const std::string &prefix,
+		      int nbits) const
+{
+  size_t nbytes = nbits / 8;
+  if(key.compare(0, nbytes, prefix, 0, nbytes) != 0) return false;
+  if(nbits % 8 == 0) return true;
+  unsigned char mask = 0xff00 >> (nbits % 8);
+  return ((key[nbytes] ^ prefix[nbytes]) & mask) == 0;
+}
+
+// the prefixes longer than offset whose first offset bits are the ones of path
+std::vector<LPMPoptrie::Rib::const_iterator>
+LPMPoptrie::get_prefixes_below(const std::string &path, int offset) const
+{
+  std::vector<Rib::const_iterator> node_prefixes;
+  const std::string start = masked_key(path.data(), offset);
+  for(auto it = rib.lower_bound(std::make_pair(start, 0));
+      it != rib.end() && same_bits(it->first.first, start, offset); ++it) {
+    if(it->first.second > offset) node_prefixes.push_back(it);
+  }
+  return node_prefixes;
+}
+
+// builds the nodes below an entry of the top table again
+void
+LPMPoptrie::rebuild(uint32_t top_index)
+{
+  std::string path(key_width_bytes, '\x00');
+  uint32_t first_bits = top_index << (24 - top_bits);
+  for(size_t i = 0; i < 3; i++)
+    path[i] = static_cast<char>(first_bits >> (16 - i * 8));
+  const auto node_prefixes = get_prefixes_below(path, top_bits);
+  const Rib::const_iterator *first = node_prefixes.data();
+  const Rib::const_iterator *last = first + node_prefixes.size();
+  const uint32_t leaf = top_leaf[top_index];
+
+  if(node_prefixes.empty()) {
+    if(top[top_index] & node_flag)
+      count_nodes(top[top_index] & ~node_flag, &garbage_nodes, &garbage_leaves);
+    top[top_index] = leaf;
+  }
+  else if(top[top_index] & node_flag) {
+    build_node(top[top_index] & ~node_flag, top_bits, leaf, first, last, true);
+  }
+  else {
+    uint32_t node = nodes.size();
+    nodes.emplace_back();
+    build_node(node, top_bits, leaf, first, last, false);
+    top[top_index] = node_flag | node;
+  }
+
+  collect_garbage();
+}
+
+// a prefix longer than top_bits only changes the node where it ends and the
+// children of that node which it covers, so only those are built again; if the
+// path to the prefix is not complete, the last node on the path is built again
+// instead, with the missing children, and if the node is not needed anymore,
+// its parent is built again instead, without it
+void
+LPMPoptrie::rebuild_path(const std::string &prefix, int prefix_length)
+{
+  uint32_t top_index = get_bits(prefix.data(), 0, top_bits);
+  if(!(top[top_index] & node_flag)) {
+    rebuild(top_index);
+    return;
+  }
+
+  std::vector<uint32_t> path(1, top[top_index] & ~node_flag);
+  for(int offset = top_bits; prefix_length > offset + stride;
+      offset += stride) {
+    const Node &n = nodes[path.back()];
+    uint32_t v = get_bits(prefix.data(), offset, stride);
+    if(!(n.vector & (1ULL << v))) break;
+    path.push_back(n.base1 + popcount(n.vector & bits_up_to(v)) - 1);
+  }
+
+  int offset = top_bits + (path.size() - 1) * stride;
+  auto node_prefixes = get_prefixes_below(prefix, offset);
+  while(node_prefixes.empty() && path.size() > 1) {
+    path.pop_back();
+    offset -= stride;
+    node_prefixes = get_prefixes_below(prefix, offset);
+  }
+  // the first node can be removed if it becomes empty
+  if(node_prefixes.empty()) {
+    rebuild(top_index);
+    return;
+  }
+
+  // the value pushed to the node
+  uint32_t leaf = top_leaf[top_index];
+  for(int length = offset; length > top_bits; length--) {
+    auto it = rib.find(std::make_pair(masked_key(prefix.data(), length), length));
+    if(it != rib.end()) {
+      leaf = it->second + 1;
+      break;
+    }
+  }
+
+  int covered_bits = std::min(prefix_length - offset, static_cast<int>(stride));
+  uint32_t first_child = get_bits(prefix.data(), offset, stride);
+  uint32_t last_child = first_child + (1u << (stride - covered_bits));
+  build_node(path.back(), offset, leaf, node_prefixes.data(),
+	     node_prefixes.data() + node_prefixes.size(), true,
+	     first_child, last_child);
+
+  collect_garbage();
+}
+
+// [first, last) are the prefixes longer than offset below the node, sorted, and
+// leaf is the value of the longest prefix covering the node; when the node is
+// built again in place and it keeps the same children, only the children in
+// [first_child, last_child) are built again (the other ones cannot change)
+void
+LPMPoptrie::build_node(uint32_t node, int offset, uint32_t leaf,
+		       const Rib::const_iterator *first,
+		       const Rib::const_iterator *last,
+		       bool in_place, uint32_t first_child, uint32_t last_child)
+{
+  // at most 2 + 4 + ... + 64 prefixes can end in the node
+  Rib::const_iterator ending[126];
+  size_t nb_ending = 0;
+  uint64_t vector = 0;
+  for(const Rib::const_iterator *it = first; it != last; ++it) {
+    int length = (*it)->first.second - offset;
+    if(length > stride)
+      vector |= 1ULL << get_bits((*it)->first.first.data(), offset, stride);
+    else if(length > 0)
+      ending[nb_ending++] = *it;
+  }
+
+  // push the prefixes ending in the node to the leaves, shortest first
+  uint32_t child_leaves[64];
+  std::fill(child_leaves, child_leaves + 64, leaf);
+  std::stable_sort(ending, ending + nb_ending,
+		   [](const Rib::const_iterator &p1,
+		      const Rib::const_iterator &p2) {
+		     return p1->first.second < p2->first.second;
+		   });
+  for(size_t i = 0; i < nb_ending; i++) {
+    uint32_t v = get_bits(ending[i]->first.first.data(), offset, stride);
+    uint32_t n = 1u << (stride - (ending[i]->first.second - offset));
+    std::fill(child_leaves + v, child_leaves + v + n, ending[i]->second + 1);
+  }
+
+  if(in_place) {
+    const Node &old = nodes[node];
+    garbage_leaves += popcount(old.leafvec);
+    if(old.vector != vector) {
+      for(int i = 0; i < popcount(old.vector); i++)
+	count_nodes(old.base1 + i, &garbage_nodes, &garbage_leaves);
+      in_place = false;
+    }
+  }
+
+  uint64_t leafvec = 0;
+  uint32_t base0 = leaves.size();
+  for(uint32_t v = 0; v < 64; v++) {
+    if(vector & (1ULL << v)) continue;
+    if(leaves.size() == base0 || leaves.back() != child_leaves[v]) {
+      leaves.push_back(child_leaves[v]);
+      leafvec |= 1ULL << v;
+    }
+  }
+
+  // the children have to be contiguous, so they are all allocated first
+  uint32_t base1;
+  if(in_place) {
+    base1 = nodes[node].base1;
+  }
+  else {
+    base1 = nodes.size();
+    nodes.resize(nodes.size() + popcount(vector));
+    first_child = 0;
+    last_child = 64;
+  }
+  nodes[node] = {vector, leafvec, base0, base1};
+
+  // the prefixes are sorted, so the ones below a given child are contiguous
+  uint32_t child = base1;
+  for(const Rib::const_iterator *it = first; it != last; ) {
+    if((*it)->first.second <= offset + stride) {
+      ++it;
+      continue;
+    }
+    uint32_t v = get_bits((*it)->first.first.data(), offset, stride);
+    const Rib::const_iterator *child_first = it;
+    while(it != last && get_bits((*it)->first.first.data(), offset, stride) == v)
+      ++it;
+    if(v >= first_child && v < last_child)
+      build_node(child, offset + stride, child_leaves[v], child_first, it,
+		 in_place);
+    child++;
+  }
+}
+
+void
+LPMPoptrie::count_nodes(uint32_t node, size_t *num_nodes,
+			size_t *num_leaves) const
+{
+  const Node &n = nodes[node];
+  (*num_nodes)++;
+  *num_leaves += popcount(n.leafvec);
+  for(int i = 0; i < popcount(n.vector); i++)
+    count_nodes(n.base1 + i, num_nodes, num_leaves);
+}
+
+// rebuilds all the nodes once there are more unused nodes or leaves than used
+// ones
+void
+LPMPoptrie::collect_garbage()
+{
+  if(garbage_nodes * 2 <= std::max(nodes.size(), size_t(4096)) &&
+     garbage_leaves * 2 <= std::max(leaves.size(), size_t(4096)))
+    return;
+  rebuild_all();
+}
+
+void
+LPMPoptrie::end_batch()
+{
+  in_batch = false;
+  std::fill(top_leaf.begin(), top_leaf.end(), 0);
+  std::fill(top_length.begin(), top_length.end(), 0);
+  for(const auto &p : rib) {
+    const int prefix_length = p.first.second;
+    if(prefix_length > top_bits) continue;
+    uint32_t first = get_bits(p.first.first.data(), 0, top_bits);
+    uint32_t last = first + (1u << (top_bits - prefix_length));
+    for(uint32_t t = first; t < last; t++) {
+      if(top_leaf[t] != 0 && top_length[t] > prefix_length) continue;
+      top_leaf[t] = p.second + 1;
+      top_length[t] = prefix_length;
+    }
+  }
+  rebuild_all();
+}
+
+// builds all the nodes again, from scratch
+void
+LPMPoptrie::rebuild_all()
+{
+  nodes.clear();
+  leaves.clear();
+  garbage_nodes = 0;
+  garbage_leaves = 0;
+  top = top_leaf;
+  // the rib is sorted, so each entry of the top table is only built once
+  uint32_t last_top_index = 0;
+  bool first = true;
+  for(const auto &p : rib) {
+    if(p.first.second <= top_bits) continue;
+    uint32_t top_index = get_bits(p.first.first.data(), 0, top_bits);
+    if(!first && top_index == last_top_index) continue;
+    rebuild(top_index);
+    last_top_index = top_index;
+    first = false;
+  }
+}
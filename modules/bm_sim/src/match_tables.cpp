@@ -24,7 +24,7 @@ namespace {
 
 template <typename V>
 std::unique_ptr<MatchUnitAbstract<V> > create_match_unit(
-  const std::string match_type,
+  const std::string match_type, const std::string match_algo,
   const size_t size, const MatchKeyBuilder &match_key_builder
 )
 {
@@ -36,9 +36,13 @@ std::unique_ptr<MatchUnitAbstract<V> > create_match_unit(
   if(match_type == "exact")
     match_unit = std::unique_ptr<MUExact>(new MUExact(size, match_key_builder));
   else if(match_type == "lpm")
-    match_unit = std::unique_ptr<MULPM>(new MULPM(size, match_key_builder));
+    match_unit = std::unique_ptr<MULPM>(
+      new MULPM(size, match_key_builder, match_algo)
+    );
   else if(match_type == "ternary")
-    match_unit = std::unique_ptr<MUTernary>(new MUTernary(size, match_key_builder));
+    match_unit = std::unique_ptr<MUTernary>(
+      new MUTernary(size, match_key_builder, match_algo)
+    );
   else
     assert(0 && "invalid match type");
   return match_unit;
@@ -163,6 +167,32 @@ MatchTable::add_entry(
   );
 }
 
+void
+MatchTable::add_entries(
+  std::vector<NewEntry> entries,
+  std::vector<MatchErrorCode> *rcs, std::vector<entry_handle_t> *handles
+)
+{
+  rcs->assign(entries.size(), MatchErrorCode::SUCCESS);
+  handles->assign(entries.size(), 0);
+
+  WriteLock lock = lock_write();
+
+  match_unit->begin_bulk_add();
+  for(size_t i = 0; i < entries.size(); i++) {
+    NewEntry &entry = entries[i];
+    const ActionFn *action_fn = entry.action_fn;
+    ActionFnEntry action_fn_entry(action_fn, std::move(entry.action_data));
+    const ControlFlowNode *next_node = get_next_node(action_fn->get_id());
+    (*rcs)[i] = match_unit->add_entry(
+      entry.match_key,
+      ActionEntry(std::move(action_fn_entry), next_node),
+      &(*handles)[i], entry.priority
+    );
+  }
+  match_unit->end_bulk_add();
+}
+
 MatchErrorCode
 MatchTable::delete_entry(entry_handle_t handle)
 {
@@ -217,13 +247,15 @@ MatchTable::reset_state_()
 
 std::unique_ptr<MatchTable>
 MatchTable::create(
-  const std::string &match_type, const std::string &name, p4object_id_t id,
+  const std::string &match_type, const std::string &match_algo,
+  const std::string &name, p4object_id_t id,
   size_t size, const MatchKeyBuilder &match_key_builder,
   bool with_counters, bool with_ageing
 )
 {
   std::unique_ptr<MatchUnitAbstract<ActionEntry> > match_unit = 
-    create_match_unit<ActionEntry>(match_type, size, match_key_builder);
+    create_match_unit<ActionEntry>(match_type, match_algo, size,
+				   match_key_builder);
 
   return std::unique_ptr<MatchTable>(
     new MatchTable(name, id, std::move(match_unit), with_counters, with_ageing)
@@ -232,14 +264,15 @@ MatchTable::create(
 
 std::unique_ptr<MatchTableIndirect>
 MatchTableIndirect::create(
-  const std::string &match_type, 
+  const std::string &match_type, const std::string &match_algo,
   const std::string &name, p4object_id_t id,
   size_t size, const MatchKeyBuilder &match_key_builder,
   bool with_counters, bool with_ageing
 )
 {
   std::unique_ptr<MatchUnitAbstract<IndirectIndex> > match_unit = 
-    create_match_unit<IndirectIndex>(match_type, size, match_key_builder);
+    create_match_unit<IndirectIndex>(match_type, match_algo, size,
+				     match_key_builder);
 
   return std::unique_ptr<MatchTableIndirect>(
     new MatchTableIndirect(name, id, std::move(match_unit), with_counters, with_ageing)
@@ -345,6 +378,32 @@ MatchTableIndirect::add_entry(
   return match_unit->add_entry(match_key, std::move(index), handle, priority);
 }
 
+void
+MatchTableIndirect::add_entries(
+  const std::vector<NewEntry> &entries,
+  std::vector<MatchErrorCode> *rcs, std::vector<entry_handle_t> *handles
+)
+{
+  rcs->assign(entries.size(), MatchErrorCode::SUCCESS);
+  handles->assign(entries.size(), 0);
+
+  WriteLock lock = lock_write();
+
+  match_unit->begin_bulk_add();
+  for(size_t i = 0; i < entries.size(); i++) {
+    const NewEntry &entry = entries[i];
+    if(!is_valid_mbr(entry.mbr)) {
+      (*rcs)[i] = MatchErrorCode::INVALID_MBR_HANDLE;
+      continue;
+    }
+    IndirectIndex index = IndirectIndex::make_mbr_index(entry.mbr);
+    (*rcs)[i] = match_unit->add_entry(entry.match_key, index,
+				      &(*handles)[i], entry.priority);
+    if((*rcs)[i] == MatchErrorCode::SUCCESS) index_ref_count.increase(index);
+  }
+  match_unit->end_bulk_add();
+}
+
 MatchErrorCode
 MatchTableIndirect::delete_entry(entry_handle_t handle)
 {
@@ -448,14 +507,15 @@ MatchTableIndirectWS::GroupInfo::get_nth(size_t n) const
 
 std::unique_ptr<MatchTableIndirectWS>
 MatchTableIndirectWS::create(
-  const std::string &match_type, 
+  const std::string &match_type, const std::string &match_algo,
   const std::string &name, p4object_id_t id,
   size_t size, const MatchKeyBuilder &match_key_builder,
   bool with_counters, bool with_ageing
 )
 {
   std::unique_ptr<MatchUnitAbstract<IndirectIndex> > match_unit = 
-    create_match_unit<IndirectIndex>(match_type, size, match_key_builder);
+    create_match_unit<IndirectIndex>(match_type, match_algo, size,
+				     match_key_builder);
 
   return std::unique_ptr<MatchTableIndirectWS>(
     new MatchTableIndirectWS(name, id, std::move(match_unit), with_counters, with_ageing)
@@ -602,6 +662,36 @@ MatchTableIndirectWS::add_entry_ws(
   return match_unit->add_entry(match_key, std::move(index), handle, priority);
 }
 
+void
+MatchTableIndirectWS::add_entries_ws(
+  const std::vector<NewEntryWS> &entries,
+  std::vector<MatchErrorCode> *rcs, std::vector<entry_handle_t> *handles
+)
+{
+  rcs->assign(entries.size(), MatchErrorCode::SUCCESS);
+  handles->assign(entries.size(), 0);
+
+  WriteLock lock = lock_write();
+
+  match_unit->begin_bulk_add();
+  for(size_t i = 0; i < entries.size(); i++) {
+    const NewEntryWS &entry = entries[i];
+    if(!is_valid_grp(entry.grp)) {
+      (*rcs)[i] = MatchErrorCode::INVALID_GRP_HANDLE;
+      continue;
+    }
+    if(get_grp_size(entry.grp) == 0) {
+      (*rcs)[i] = MatchErrorCode::EMPTY_GRP;
+      continue;
+    }
+    IndirectIndex index = IndirectIndex::make_grp_index(entry.grp);
+    (*rcs)[i] = match_unit->add_entry(entry.match_key, index,
+				      &(*handles)[i], entry.priority);
+    if((*rcs)[i] == MatchErrorCode::SUCCESS) index_ref_count.increase(index);
+  }
+  match_unit->end_bulk_add();
+}
+
 MatchErrorCode
 MatchTableIndirectWS::modify_entry_ws(
   entry_handle_t handle, grp_hdl_t grp
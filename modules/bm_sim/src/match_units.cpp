@@ -116,8 +116,9 @@ template<typename V>
 typename MatchUnitAbstract<V>::MatchUnitLookup
 MatchUnitAbstract<V>::lookup(const Packet &pkt)
 {
+  // shared by all the tables, it only allocates if a key does not fit inline
+  // and is wider than all the previous ones
   static thread_local ByteContainer key;
-  key.clear();
   build_key(*pkt.get_phv(), key);
 
   MatchUnitLookup res = lookup_key(key);
@@ -181,11 +182,11 @@ template<typename V>
 typename MatchUnitExact<V>::MatchUnitLookup
 MatchUnitExact<V>::lookup_key(const ByteContainer &key) const
 {
-  const auto entry_it = entries_map.find(key);
+  internal_handle_t handle_;
   // std::cout << "looking up: " << key.to_hex() << "\n";
-  if(entry_it == entries_map.end()) return MatchUnitLookup::empty_entry();
-  const Entry &entry = entries[entry_it->second];
-  entry_handle_t handle = HANDLE_SET(entry.version, entry_it->second);
+  if(!entries_map.lookup(key, &handle_)) return MatchUnitLookup::empty_entry();
+  const Entry &entry = entries[handle_];
+  entry_handle_t handle = HANDLE_SET(entry.version, handle_);
   return MatchUnitLookup(handle, &entry.value);
 }
 
@@ -224,7 +225,7 @@ MatchUnitExact<V>::add_entry_(
   assert(new_key.size() == this->nbytes_key);
 
   // check if the key is already present
-  if(entries_map.find(new_key) != entries_map.end())
+  if(entries_map.has_key(new_key))
     return MatchErrorCode::DUPLICATE_ENTRY;
 
   internal_handle_t handle_;
@@ -234,7 +235,7 @@ MatchUnitExact<V>::add_entry_(
   uint32_t version = entries[handle_].version;
   *handle = HANDLE_SET(version, handle_);
 
-  entries_map[new_key] = handle_; // key is copied, which is not great
+  entries_map.insert(new_key, handle_);
   entries[handle_] = Entry(std::move(new_key), std::move(value), version);
   
   return MatchErrorCode::SUCCESS;
@@ -250,7 +251,7 @@ MatchUnitExact<V>::delete_entry_(entry_handle_t handle)
   if(HANDLE_VERSION(handle) != entry.version)
     return MatchErrorCode::EXPIRED_HANDLE;
   entry.version += 1;
-  entries_map.erase(entry.key);
+  entries_map.remove(entry.key);
 
   return this->unset_handle(handle_);
 }
@@ -303,12 +304,53 @@ MatchUnitExact<V>::reset_state_()
   entries_map.clear();
 }
 
+template<typename V>
+void
+MatchUnitLPM<V>::begin_bulk_add_()
+{
+  entries_trie->begin_batch();
+}
+
+template<typename V>
+void
+MatchUnitLPM<V>::end_bulk_add_()
+{
+  entries_trie->end_batch();
+}
+
+template<typename V>
+std::unique_ptr<LPMIndex>
+MatchUnitLPM<V>::create_index(size_t size,
+			      const MatchKeyBuilder &match_key_builder,
+			      const std::string &match_algo)
+{
+  size_t nbytes_key = match_key_builder.get_nbytes_key();
+  size_t nb_valid = match_key_builder.valid_headers.size();
+  // handles have to fit in a DIR-24-8 entry
+  bool fits_dir24_8 = (nbytes_key == nb_valid + 4) &&
+    (nb_valid <= LPMDir24_8::max_valid_bytes) &&
+    (size <= LPMDir24_8::max_value);
+  bool default_dir24_8 = fits_dir24_8 && (nb_valid == 0) &&
+    (size >= LPMDir24_8::min_default_size);
+  if(match_algo == "dir24_8" || (match_algo == "" && default_dir24_8)) {
+    assert(fits_dir24_8);
+    return std::unique_ptr<LPMIndex>(new LPMDir24_8(nbytes_key));
+  }
+  if(match_algo == "poptrie") {
+    assert(nbytes_key * 8 >= LPMPoptrie::top_bits);
+    assert(size <= LPMPoptrie::max_value);
+    return std::unique_ptr<LPMIndex>(new LPMPoptrie(nbytes_key));
+  }
+  assert((match_algo == "" || match_algo == "trie") && "invalid lpm match algo");
+  return std::unique_ptr<LPMIndex>(new LPMTrie(nbytes_key));
+}
+
 template<typename V>
 typename MatchUnitLPM<V>::MatchUnitLookup
 MatchUnitLPM<V>::lookup_key(const ByteContainer &key) const
 {
   internal_handle_t handle_;
-  if(entries_trie.lookup(key, &handle_)) {
+  if(entries_trie->lookup(key, &handle_)) {
     const Entry &entry = entries[handle_];
     entry_handle_t handle = HANDLE_SET(entry.version, handle_);
     return MatchUnitLookup(handle, &entry.value);
@@ -360,7 +402,7 @@ MatchUnitLPM<V>::add_entry_(
   assert(new_key.size() == this->nbytes_key);
 
   // check if the key is already present
-  if(entries_trie.has_prefix(new_key, prefix_length))
+  if(entries_trie->has_prefix(new_key, prefix_length))
     return MatchErrorCode::DUPLICATE_ENTRY;
 
   internal_handle_t handle_;
@@ -371,7 +413,7 @@ MatchUnitLPM<V>::add_entry_(
   *handle = HANDLE_SET(version, handle_);
   
   // key is copied, which is not great
-  entries_trie.insert_prefix(new_key, prefix_length, handle_);
+  entries_trie->insert_prefix(new_key, prefix_length, handle_);
   entries[handle_] = Entry(std::move(new_key), prefix_length,
 			   std::move(value), version);
   
@@ -388,7 +430,7 @@ MatchUnitLPM<V>::delete_entry_(entry_handle_t handle)
   if(HANDLE_VERSION(handle) != entry.version)
     return MatchErrorCode::EXPIRED_HANDLE;
   entry.version += 1;
-  assert(entries_trie.delete_prefix(entry.key, entry.prefix_length));
+  assert(entries_trie->delete_prefix(entry.key, entry.prefix_length));
 
   return this->unset_handle(handle_);
 }
@@ -439,7 +481,7 @@ void
 MatchUnitLPM<V>::reset_state_()
 {
   entries = std::vector<Entry>(this->size);
-  entries_trie.clear();
+  entries_trie->clear();
 }
 
 
@@ -447,6 +489,15 @@ template<typename V>
 typename MatchUnitTernary<V>::MatchUnitLookup
 MatchUnitTernary<V>::lookup_key(const ByteContainer &key) const
 {
+  if(classifier) {
+    internal_handle_t handle_;
+    if(!classifier->lookup(key, &handle_))
+      return MatchUnitLookup::empty_entry();
+    const Entry &entry = entries[handle_];
+    entry_handle_t handle = HANDLE_SET(entry.version, handle_);
+    return MatchUnitLookup(handle, &entry.value);
+  }
+
   int min_priority = std::numeric_limits<int>::max();;
   bool match;
 
@@ -559,26 +610,37 @@ MatchUnitTernary<V>::add_entry_(
   
   entries[handle_] = Entry(std::move(new_key), std::move(new_mask), priority,
 			   std::move(value), version);
+  const Entry &entry = entries[handle_];
+  ByteContainer rule_key;
+  build_rule_key(entry.key, entry.mask, priority, &rule_key);
+  rules_index.insert(rule_key, handle_);
+  if(classifier) classifier->insert(handle_, entry.key, entry.mask, priority);
   
   return MatchErrorCode::SUCCESS;
 }
 
+template<typename V>
+void
+MatchUnitTernary<V>::build_rule_key(
+  const ByteContainer &key, const ByteContainer &mask, int priority,
+  ByteContainer *rule_key
+) const
+{
+  rule_key->clear();
+  rule_key->append(key);
+  rule_key->append(mask);
+  rule_key->append(reinterpret_cast<const char *>(&priority), sizeof(priority));
+}
+
 template<typename V>
 bool
 MatchUnitTernary<V>::has_rule(
   const ByteContainer &key, const ByteContainer &mask, int priority
 ) const
 {
-  for(auto it = this->handles.begin(); it != this->handles.end(); ++it) {
-    const Entry &entry = entries[*it];
-
-    if(entry.priority == priority &&
-       entry.key == key &&
-       entry.mask == mask) {
-      return true;
-    }
-  }
-  return false;
+  ByteContainer rule_key;
+  build_rule_key(key, mask, priority, &rule_key);
+  return rules_index.has_key(rule_key);
 }
 
 template<typename V>
@@ -591,6 +653,11 @@ MatchUnitTernary<V>::delete_entry_(entry_handle_t handle)
   if(HANDLE_VERSION(handle) != entry.version)
     return MatchErrorCode::EXPIRED_HANDLE;
   entry.version += 1;
+  ByteContainer rule_key;
+  build_rule_key(entry.key, entry.mask, entry.priority, &rule_key);
+  rules_index.remove(rule_key);
+  if(classifier)
+    classifier->remove(handle_, entry.key, entry.mask, entry.priority);
 
   return this->unset_handle(handle_);
 }
@@ -641,6 +708,22 @@ void
 MatchUnitTernary<V>::reset_state_()
 {
   entries = std::vector<Entry>(this->size);
+  rules_index.clear();
+  if(classifier) classifier->clear();
+}
+
+template<typename V>
+void
+MatchUnitTernary<V>::begin_bulk_add_()
+{
+  if(classifier) classifier->begin_batch();
+}
+
+template<typename V>
+void
+MatchUnitTernary<V>::end_bulk_add_()
+{
+  if(classifier) classifier->end_batch();
 }
 
 
@@ -29,6 +29,7 @@
 
 #include "bm_sim/options_parse.h"
 #include "bm_sim/event_logger.h"
+#include "bm_sim/thread_affinity.h"
 
 struct interface {
   interface(const std::string &name, int port)
@@ -72,7 +73,7 @@ void validate(boost::any& v,
 }
 
 void
-OptionsParser::parse(int argc, char *argv[])
+OptionsParser::parse(int argc, char *argv[], bool threading_options)
 {
   namespace po = boost::program_options;
 
@@ -85,13 +86,42 @@ OptionsParser::parse(int argc, char *argv[])
      "Attach network interface <interface-name> as port <port-num> at startup. "
      "Can appear multiple times")
     ("pcap", "Generate pcap files for interfaces")
+    ("hugepages", "Back packet buffers with huge pages when available")
+    ("no-packet-signature",
+     "Do not hash packets to compute their signature, which is then always 0 "
+     "in event logger messages")
     ("thrift-port", po::value<int>(),
      "TCP port on which to run the Thrift runtime server")
+    ("ingress-cpus", po::value<std::string>(),
+     "CPUs to pin the ingress threads to, one CPU per thread in turn, "
+     "e.g. 0-3,8")
+    ("egress-cpus", po::value<std::string>(),
+     "CPUs to pin the egress threads to, one CPU per thread in turn")
+    ("transmit-cpus", po::value<std::string>(),
+     "CPUs the transmit thread can run on")
+    ("rx-cpus", po::value<std::string>(),
+     "CPUs the thread receiving packets from the interfaces can run on")
+    ("thrift-cpus", po::value<std::string>(),
+     "CPUs the Thrift runtime server threads can run on")
     ("device-id", po::value<int>(),
      "Device ID, used to identify the device in IPC messages (default 0)")
     ("nanolog", po::value<std::string>(),
      "IPC socket to use for nanomsg pub/sub logs (default: no nanomsg logging");
 
+  // only for the targets which honor them, the others reject them as unknown
+  if(threading_options) {
+    description.add_options()
+      ("ingress-threads", po::value<int>(),
+       "Number of threads running the ingress pipeline (default 1)")
+      ("egress-threads", po::value<int>(),
+       "Number of threads servicing the egress queues (default 1)")
+      ("priority-queues", po::value<int>(),
+       "Number of priority queues per egress port (default 1)")
+      ("run-to-completion",
+       "Process each packet from start to end on the thread which receives "
+       "it");
+  }
+
   po::options_description hidden;
   hidden.add_options()
     ("input-config", po::value<std::string>(), "input config");
@@ -134,6 +164,30 @@ OptionsParser::parse(int argc, char *argv[])
     device_id = vm["device-id"].as<int>();
   }
 
+  if(vm.count("ingress-threads")) {
+    ingress_threads = vm["ingress-threads"].as<int>();
+    if(ingress_threads < 1) {
+      std::cout << "Error: invalid number of ingress threads\n";
+      exit(1);
+    }
+  }
+
+  if(vm.count("egress-threads")) {
+    egress_threads = vm["egress-threads"].as<int>();
+    if(egress_threads < 1) {
+      std::cout << "Error: invalid number of egress threads\n";
+      exit(1);
+    }
+  }
+
+  if(vm.count("priority-queues")) {
+    priority_queues = vm["priority-queues"].as<int>();
+    if(priority_queues < 1) {
+      std::cout << "Error: invalid number of priority queues\n";
+      exit(1);
+    }
+  }
+
   // event_logger_addr = std::string("ipc:///tmp/bm-")
   //   .append(std::to_string(device_id))
   //   .append("-log.ipc");
@@ -154,6 +208,34 @@ OptionsParser::parse(int argc, char *argv[])
     pcap = true;
   }
 
+  if(vm.count("hugepages")) {
+    hugepages = true;
+  }
+
+  if(vm.count("no-packet-signature")) {
+    packet_signatures = false;
+  }
+
+  if(vm.count("run-to-completion")) {
+    run_to_completion = true;
+  }
+
+  const std::pair<const char *, std::vector<int> *> cpu_options[] = {
+    {"ingress-cpus", &ingress_cpus},
+    {"egress-cpus", &egress_cpus},
+    {"transmit-cpus", &transmit_cpus},
+    {"rx-cpus", &rx_cpus},
+    {"thrift-cpus", &thrift_cpus},
+  };
+  for(const auto &option : cpu_options) {
+    if(!vm.count(option.first)) continue;
+    const std::string &str = vm[option.first].as<std::string>();
+    if(!ThreadAffinity::parse_cpu_list(str, option.second)) {
+      std::cout << "Error: invalid CPU list for --" << option.first << "\n";
+      exit(1);
+    }
+  }
+
   assert(vm.count("input-config"));
   config_file_path = vm["input-config"].as<std::string>();
 
@@ -18,13 +18,120 @@
  *
  */
 
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <functional>
+
 #include "bm_sim/packet.h"
 
 #include "xxhash.h"
 
+namespace {
+
+// Each thread has its own cache of objects, so that getting and releasing an
+// object does not require any synchronization most of the time. The caches
+// refill from / spill to a shared depot, one batch at a time. Because the
+// caches are thread_local, there must be only one pool of a given type T at a
+// time; the caches of a previous pool are discarded on first use.
+template <typename T>
+class ThreadCachedPool {
+public:
+  typedef std::function<T()> CreateFn;
+
+  explicit ThreadCachedPool(CreateFn create)
+    : create(std::move(create)), id(++next_id) { }
+
+  T get() {
+    Cache &cache = get_cache();
+    if(cache.items.empty()) {
+      std::unique_lock<std::mutex> lock(depot_mutex);
+      size_t n = std::min(batch_size, depot.size());
+      for(size_t i = 0; i < n; i++) {
+	cache.items.push_back(std::move(depot.back()));
+	depot.pop_back();
+      }
+    }
+    if(cache.items.empty()) return create();
+    T item = std::move(cache.items.back());
+    cache.items.pop_back();
+    return item;
+  }
+
+  void release(T item) {
+    Cache &cache = get_cache();
+    cache.items.push_back(std::move(item));
+    // keep one batch around, in case this thread allocates as well
+    if(cache.items.size() >= 2 * batch_size) {
+      std::unique_lock<std::mutex> lock(depot_mutex);
+      for(size_t i = 0; i < batch_size; i++) {
+	depot.push_back(std::move(cache.items.back()));
+	cache.items.pop_back();
+      }
+    }
+  }
+
+  void prewarm(size_t num_items) {
+    std::unique_lock<std::mutex> lock(depot_mutex);
+    depot.reserve(num_items);
+    while(depot.size() < num_items)
+      depot.push_back(create());
+  }
+
+private:
+  struct Cache {
+    uint64_t pool_id{0};
+    std::vector<T> items{};
+  };
+
+  Cache &get_cache() {
+    static thread_local Cache cache;
+    if(cache.pool_id != id) {
+      cache.items.clear();
+      cache.pool_id = id;
+    }
+    return cache;
+  }
+
+private:
+  static const size_t batch_size = 32;
+  static std::atomic<uint64_t> next_id;
+
+  CreateFn create;
+  const uint64_t id;
+  std::mutex depot_mutex{};
+  std::vector<T> depot{};
+};
+
+template <typename T>
+std::atomic<uint64_t> ThreadCachedPool<T>::next_id{0};
+
+typedef std::unique_ptr<char[]> PacketMemory;
+
+ThreadCachedPool<PacketMemory> *get_packet_memory_pool() {
+  // leaked on purpose, like phv_pool
+  static ThreadCachedPool<PacketMemory> *pool =
+    new ThreadCachedPool<PacketMemory>([]() {
+	return PacketMemory(new char[sizeof(Packet)]);
+      });
+  return pool;
+}
+
+}
+
+class Packet::PHVPool : public ThreadCachedPool<std::unique_ptr<PHV> > {
+public:
+  PHVPool(const PHVFactory &phv_factory)
+    : ThreadCachedPool<std::unique_ptr<PHV> >(
+	[&phv_factory]() { return phv_factory.create(); }
+      ) { }
+};
+
 void
-Packet::update_signature(unsigned long long seed) {
-  signature = XXH64(buffer.start(), buffer.get_data_size(), seed);
+Packet::update_signature(unsigned long long seed) const {
+  if(signatures_enabled)
+    signature = XXH64(buffer.start(), buffer.get_data_size(), seed);
+  signature_valid = true;
 }
 
 void
@@ -45,7 +152,6 @@ Packet::Packet(int ingress_port, packet_id_t id, packet_id_t copy_id,
   : ingress_port(ingress_port), packet_id(id), copy_id(copy_id),
     ingress_length(ingress_length), buffer(std::move(buffer)) {
   assert(phv_pool);
-  update_signature();
   set_ingress_ts();
   phv = phv_pool->get();
 }
@@ -55,7 +161,6 @@ Packet::Packet(int ingress_port, packet_id_t id, packet_id_t copy_id,
   : ingress_port(ingress_port), packet_id(id), copy_id(copy_id),
     ingress_length(ingress_length), buffer(std::move(buffer)) {
   assert(phv_pool);
-  update_signature();
   set_ingress_ts();
   phv = phv_pool->get();
   phv->copy_headers(src_phv);
@@ -63,6 +168,11 @@ Packet::Packet(int ingress_port, packet_id_t id, packet_id_t copy_id,
   
 Packet::~Packet() {
   assert(phv);
+  release_phv(std::move(phv));
+}
+
+void
+Packet::release_phv(std::unique_ptr<PHV> phv) {
   // corner case: phv_pool has already been destroyed
   if(phv_pool) {
     phv->reset();
@@ -87,6 +197,24 @@ Packet::clone_and_reset_metadata(packet_id_t new_copy_id) const {
   return pkt;
 }
 
+Packet
+Packet::clone_cow(packet_id_t new_copy_id) {
+  if(!shared_phv || !phv->shares_headers_with(*shared_phv)) {
+    // the frozen PHV will be read concurrently by the copies
+    phv->sync();
+    shared_phv = std::shared_ptr<const PHV>(
+      phv.release(),
+      [](PHV *p) { release_phv(std::unique_ptr<PHV>(p)); }
+    );
+    phv = phv_pool->get();
+    phv->share_headers(shared_phv);
+  }
+  Packet pkt(ingress_port, packet_id, new_copy_id, ingress_length,
+	     buffer.clone(buffer.get_data_size()));
+  pkt.phv->share_headers(shared_phv);
+  return pkt;
+}
+
 /* Cannot get away with defaults here, we need to swap the phvs, otherwise we
    could "leak" the old phv (i.e. not put it back into the pool) */
 
@@ -94,9 +222,11 @@ Packet::Packet(Packet &&other) noexcept
   : ingress_port(other.ingress_port), egress_port(other.egress_port),
     packet_id(other.packet_id), copy_id(other.copy_id),
     ingress_length(other.ingress_length),
-    signature(other.signature), payload_size(other.payload_size) {
-  buffer = std::move(buffer);
+    signature(other.signature), signature_valid(other.signature_valid),
+    payload_size(other.payload_size) {
+  buffer = std::move(other.buffer);
   std::swap(phv, other.phv);
+  std::swap(shared_phv, other.shared_phv);
 }
 
 Packet &
@@ -107,16 +237,25 @@ Packet::operator=(Packet &&other) noexcept {
   copy_id = other.copy_id;
   ingress_length = other.ingress_length;
   signature = other.signature;
+  signature_valid = other.signature_valid;
   payload_size = other.payload_size;
 
   std::swap(buffer, other.buffer);
   std::swap(phv, other.phv);
+  std::swap(shared_phv, other.shared_phv);
 
   return *this;
 }
 
 Packet::PHVPool *Packet::phv_pool = nullptr;
 
+bool Packet::signatures_enabled = true;
+
+void
+Packet::set_signatures_enabled(bool enabled) {
+  signatures_enabled = enabled;
+}
+
 void
 Packet::set_phv_factory(const PHVFactory &phv_factory) {
   assert(!phv_pool);
@@ -137,25 +276,22 @@ Packet::swap_phv_factory(const PHVFactory &phv_factory) {
   phv_pool = new PHVPool(phv_factory);
 }
 
-Packet::PHVPool::PHVPool(const PHVFactory &phv_factory)
-  : phv_factory(phv_factory) {
-  phvs.push_back(std::move(phv_factory.create()));
+void
+Packet::prewarm(size_t num_packets) {
+  assert(phv_pool);
+  phv_pool->prewarm(num_packets);
+  get_packet_memory_pool()->prewarm(num_packets);
 }
 
-std::unique_ptr<PHV>
-Packet::PHVPool::get() {
-  std::unique_lock<std::mutex> lock(mutex);
-  if(phvs.size() == 0) {
-    lock.unlock();
-    return phv_factory.create();
-  }
-  std::unique_ptr<PHV> phv = std::move(phvs.back());
-  phvs.pop_back();
-  return phv;
+void *
+Packet::operator new(size_t size) {
+  if(size != sizeof(Packet)) return ::operator new(size);
+  return get_packet_memory_pool()->get().release();
 }
 
 void
-Packet::PHVPool::release(std::unique_ptr<PHV> phv) {
-  std::unique_lock<std::mutex> lock(mutex);
-  phvs.push_back(std::move(phv));
+Packet::operator delete(void *ptr, size_t size) {
+  if(!ptr) return;
+  if(size != sizeof(Packet)) return ::operator delete(ptr);
+  get_packet_memory_pool()->release(PacketMemory(static_cast<char *>(ptr)));
 }
@@ -0,0 +1,169 @@
+/* Copyright 2013-present Barefoot Networks, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Antonin Bas (antonin@barefootnetworks.com)
+ *
+ */
+
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <new>
+
+#include <sys/mman.h>
+
+#include "bm_sim/packet_buffer.h"
+
+namespace {
+
+// 2MB, i.e. the size of a huge page on x86
+const size_t slab_size = 2 << 20;
+
+const size_t magazine_size = 64;
+
+typedef std::vector<char *> Magazine;
+
+struct SizeClass {
+  SizeClass(size_t buffer_size)
+    : buffer_size(buffer_size) { }
+
+  size_t buffer_size;
+  std::mutex mutex{};
+  // the depot, shared by all threads
+  std::vector<Magazine> full_magazines{};
+  std::vector<Magazine> empty_magazines{};
+};
+
+const int num_size_classes = 2;
+
+// leaked on purpose, the packet processing threads are never joined
+SizeClass *get_size_classes() {
+  // 9KB is enough for a jumbo frame
+  static SizeClass *size_classes = new SizeClass[num_size_classes]{
+    {2048}, {9216}
+  };
+  return size_classes;
+}
+
+std::atomic<bool> hugepages{false};
+
+int get_size_class(size_t size) {
+  const SizeClass *size_classes = get_size_classes();
+  for(int c = 0; c < num_size_classes; c++) {
+    if(size <= size_classes[c].buffer_size) return c;
+  }
+  return -1;
+}
+
+char *allocate_slab() {
+  void *mem = MAP_FAILED;
+  const int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+#ifdef MAP_HUGETLB
+  if(hugepages)
+    mem = mmap(NULL, slab_size, PROT_READ | PROT_WRITE, flags | MAP_HUGETLB,
+	       -1, 0);
+#endif
+  // fall back to regular pages if no huge page is available
+  if(mem == MAP_FAILED)
+    mem = mmap(NULL, slab_size, PROT_READ | PROT_WRITE, flags, -1, 0);
+  if(mem == MAP_FAILED)
+    throw std::bad_alloc();
+  return static_cast<char *>(mem);
+}
+
+// slabs are never returned to the system, the depot mutex must be held
+void grow(SizeClass &sc) {
+  char *slab = allocate_slab();
+  size_t num_buffers = slab_size / sc.buffer_size;
+  Magazine magazine;
+  magazine.reserve(magazine_size);
+  for(size_t i = 0; i < num_buffers; i++) {
+    magazine.push_back(slab + i * sc.buffer_size);
+    if(magazine.size() == magazine_size) {
+      sc.full_magazines.push_back(std::move(magazine));
+      magazine = Magazine();
+      magazine.reserve(magazine_size);
+    }
+  }
+  if(!magazine.empty())
+    sc.full_magazines.push_back(std::move(magazine));
+}
+
+// each thread has one loaded magazine per size class
+struct ThreadMagazines {
+  Magazine loaded[num_size_classes];
+
+  ~ThreadMagazines() {
+    // give the buffers back to the depot when the thread exits
+    for(int c = 0; c < num_size_classes; c++) {
+      if(loaded[c].empty()) continue;
+      SizeClass &sc = get_size_classes()[c];
+      std::unique_lock<std::mutex> lock(sc.mutex);
+      sc.full_magazines.push_back(std::move(loaded[c]));
+    }
+  }
+};
+
+thread_local ThreadMagazines magazines;
+
+}
+
+char *
+PacketBufferAllocator::allocate(size_t size) {
+  int c = get_size_class(size);
+  if(c < 0) return new char[size];
+  Magazine &loaded = magazines.loaded[c];
+  if(loaded.empty()) {
+    SizeClass &sc = get_size_classes()[c];
+    std::unique_lock<std::mutex> lock(sc.mutex);
+    if(sc.full_magazines.empty()) grow(sc);
+    if(loaded.capacity() > 0) sc.empty_magazines.push_back(std::move(loaded));
+    loaded = std::move(sc.full_magazines.back());
+    sc.full_magazines.pop_back();
+  }
+  char *ptr = loaded.back();
+  loaded.pop_back();
+  return ptr;
+}
+
+void
+PacketBufferAllocator::deallocate(char *ptr, size_t size) {
+  int c = get_size_class(size);
+  if(c < 0) {
+    delete[] ptr;
+    return;
+  }
+  Magazine &loaded = magazines.loaded[c];
+  if(loaded.size() >= magazine_size) {
+    SizeClass &sc = get_size_classes()[c];
+    std::unique_lock<std::mutex> lock(sc.mutex);
+    sc.full_magazines.push_back(std::move(loaded));
+    if(!sc.empty_magazines.empty()) {
+      loaded = std::move(sc.empty_magazines.back());
+      sc.empty_magazines.pop_back();
+    }
+    else {
+      loaded = Magazine();
+      loaded.reserve(magazine_size);
+    }
+  }
+  loaded.push_back(ptr);
+}
+
+void
+PacketBufferAllocator::use_hugepages(bool enable) {
+  hugepages = enable;
+}
@@ -21,8 +21,12 @@
 #include "bm_sim/phv.h"
 
 void PHV::reset() {
-  for(auto &h : headers)
-    h.mark_invalid();
+  generations.valid++;
+  if(cow_source) {
+    for(auto &h : headers)
+      h.unlink();
+    cow_source.reset();
+  }
 }
 
 void PHV::reset_header_stacks() {
@@ -30,11 +34,41 @@ void PHV::reset_header_stacks() {
     hs.reset();
 }
 
-// so slow I want to die, but optional for a target...
-// I need to find a better way of doing this
+// the metadata fields are zeroed lazily by each header, on first access
 void PHV::reset_metadata() {
-  for(auto &h : headers) {
-    if(h.is_metadata())
-      h.reset();
+  generations.metadata++;
+}
+
+void PHV::share_headers(const std::shared_ptr<const PHV> &src) {
+  for(unsigned int h = 0; h < headers.size(); h++) {
+    const Header &src_hdr = src->headers[h];
+    headers[h].metadata = src_hdr.metadata;
+    if(src_hdr.is_valid()) {
+      headers[h].mark_valid();
+      headers[h].share_fields(src_hdr);
+    }
+    else {
+      headers[h].mark_invalid();
+      headers[h].unlink();
+    }
+  }
+  // src may itself be sharing headers, in which case we point directly to its
+  // own source, which it keeps alive
+  cow_source = src;
+}
+
+bool PHV::shares_headers_with(const PHV &src) const {
+  if(!cow_source) return false;
+  for(unsigned int h = 0; h < headers.size(); h++) {
+    const Header &hdr = headers[h];
+    const Header &src_hdr = src.headers[h];
+    if(hdr.is_valid() != src_hdr.is_valid()) return false;
+    if(hdr.is_valid() && !hdr.shares_fields_with(src_hdr)) return false;
   }
+  return true;
+}
+
+void PHV::sync() const {
+  for(const auto &h : headers)
+    h.sync();
 }
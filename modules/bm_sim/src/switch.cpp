@@ -24,6 +24,7 @@
 #include "bm_sim/switch.h"
 #include "bm_sim/P4Objects.h"
 #include "bm_sim/options_parse.h"
+#include "bm_sim/thread_affinity.h"
 
 Switch::Switch(bool enable_swap)
   : DevMgr(),
@@ -64,7 +65,21 @@ Switch::init_objects(const std::string &json_path) {
 int
 Switch::init_from_command_line_options(int argc, char *argv[]) {
   OptionsParser parser;
-  parser.parse(argc, argv);
+  parser.parse(argc, argv, has_threading_options());
+  PacketBufferAllocator::use_hugepages(parser.hugepages);
+  Packet::set_signatures_enabled(parser.packet_signatures);
+  nb_ingress_threads = parser.ingress_threads;
+  nb_egress_threads = parser.egress_threads;
+  nb_priority_queues = parser.priority_queues;
+  run_to_completion = parser.run_to_completion;
+  ThreadAffinity::set_cpus(ThreadAffinity::Role::INGRESS, parser.ingress_cpus);
+  ThreadAffinity::set_cpus(ThreadAffinity::Role::EGRESS, parser.egress_cpus);
+  ThreadAffinity::set_cpus(ThreadAffinity::Role::TRANSMIT,
+			   parser.transmit_cpus);
+  ThreadAffinity::set_cpus(ThreadAffinity::Role::RX, parser.rx_cpus);
+  ThreadAffinity::set_cpus(ThreadAffinity::Role::THRIFT, parser.thrift_cpus);
+  ThreadAffinity::pin_thread(get_rx_thread(), ThreadAffinity::Role::RX);
+  options_parsed();
   int status = init_objects(parser.config_file_path);
   if(status != 0) return status;
   for(const auto &iface : parser.ifaces) {
@@ -105,6 +120,46 @@ Switch::mt_add_entry(
   );
 }
 
+MatchErrorCode
+Switch::mt_add_entries(
+    const std::string &table_name,
+    std::vector<NewEntry> entries,
+    std::vector<MatchErrorCode> *rcs,
+    std::vector<entry_handle_t> *handles
+) {
+  boost::shared_lock<boost::shared_mutex> lock(request_mutex);
+  MatchTableAbstract *abstract_table = 
+    p4objects_rt->get_abstract_match_table(table_name);
+  if(!abstract_table) return MatchErrorCode::INVALID_TABLE_NAME;
+  MatchTable *table = dynamic_cast<MatchTable *>(abstract_table);
+  if(!table) return MatchErrorCode::WRONG_TABLE_TYPE;
+  rcs->assign(entries.size(), MatchErrorCode::INVALID_ACTION_NAME);
+  handles->assign(entries.size(), 0);
+  // an entry with an unknown action fails on its own, the others are added
+  std::vector<MatchTable::NewEntry> table_entries;
+  std::vector<size_t> positions;
+  table_entries.reserve(entries.size());
+  positions.reserve(entries.size());
+  for(size_t i = 0; i < entries.size(); i++) {
+    NewEntry &entry = entries[i];
+    const ActionFn *action = p4objects_rt->get_action(entry.action_name);
+    if(!action) continue;
+    table_entries.push_back(
+      {std::move(entry.match_key), action, std::move(entry.action_data),
+       entry.priority}
+    );
+    positions.push_back(i);
+  }
+  std::vector<MatchErrorCode> table_rcs;
+  std::vector<entry_handle_t> table_handles;
+  table->add_entries(std::move(table_entries), &table_rcs, &table_handles);
+  for(size_t i = 0; i < positions.size(); i++) {
+    (*rcs)[positions[i]] = table_rcs[i];
+    (*handles)[positions[i]] = table_handles[i];
+  }
+  return MatchErrorCode::SUCCESS;
+}
+
 MatchErrorCode
 Switch::mt_set_default_action(
     const std::string &table_name,
@@ -240,6 +295,22 @@ Switch::mt_indirect_add_entry(
   return table->add_entry(match_key, mbr, handle, priority);
 }
 
+MatchErrorCode
+Switch::mt_indirect_add_entries(
+  const std::string &table_name,
+  const std::vector<IndirectNewEntry> &entries,
+  std::vector<MatchErrorCode> *rcs, std::vector<entry_handle_t> *handles
+)
+{
+  MatchErrorCode rc;
+  MatchTableIndirect *table;
+  boost::shared_lock<boost::shared_mutex> lock(request_mutex);
+  if((rc = get_mt_indirect(table_name, &table)) != MatchErrorCode::SUCCESS)
+    return rc;
+  table->add_entries(entries, rcs, handles);
+  return MatchErrorCode::SUCCESS;
+}
+
 MatchErrorCode
 Switch::mt_indirect_modify_entry(
   const std::string &table_name, entry_handle_t handle, mbr_hdl_t mbr
@@ -372,6 +443,22 @@ Switch::mt_indirect_ws_add_entry(
   return table->add_entry_ws(match_key, grp, handle, priority);
 }
 
+MatchErrorCode
+Switch::mt_indirect_ws_add_entries(
+  const std::string &table_name,
+  const std::vector<IndirectWSNewEntry> &entries,
+  std::vector<MatchErrorCode> *rcs, std::vector<entry_handle_t> *handles
+)
+{
+  MatchErrorCode rc;
+  MatchTableIndirectWS *table;
+  boost::shared_lock<boost::shared_mutex> lock(request_mutex);
+  if((rc = get_mt_indirect_ws(table_name, &table)) != MatchErrorCode::SUCCESS)
+    return rc;
+  table->add_entries_ws(entries, rcs, handles);
+  return MatchErrorCode::SUCCESS;
+}
+
 MatchErrorCode
 Switch::mt_indirect_ws_modify_entry(
   const std::string &table_name, entry_handle_t handle, grp_hdl_t grp
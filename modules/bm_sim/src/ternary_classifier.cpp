@@ -0,0 +1,311 @@
+/* Copyright 2013-present Barefoot Networks, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Antonin Bas (antonin@barefootnetworks.com)
+ *
+ */
+
+#include <algorithm>
+
+#include <cassert>
+#include <cstring>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#include "bm_sim/ternary_classifier.h"
+
+std::unique_ptr<TernaryClassifier>
+TernaryClassifier::create(const std::string &algo, size_t nbytes_key)
+{
+  if(algo == "" || algo == "linear")
+    return nullptr;
+  if(algo == "tuple_space")
+    return std::unique_ptr<TernaryClassifier>(
+      new TupleSpaceClassifier(nbytes_key)
+    );
+  if(algo == "packed_scan")
+    return std::unique_ptr<TernaryClassifier>(
+      new PackedScanClassifier(nbytes_key)
+    );
+  assert(0 && "invalid ternary match algo");
+  return nullptr;
+}
+
+void
+TupleSpaceClassifier::insert(handle_t handle, const ByteContainer &key,
+			     const ByteContainer &mask, int priority)
+{
+  auto it = tuples.find(mask);
+  if(it == tuples.end()) {
+    it = tuples.emplace(
+      mask, std::unique_ptr<Tuple>(new Tuple(mask, nbytes_key))
+    ).first;
+    sorted_tuples.push_back(it->second.get());
+  }
+  Tuple &tuple = *it->second;
+
+  ExactMap::value_t bucket;
+  if(!tuple.index.lookup(key, &bucket)) {
+    if(!tuple.free_buckets.empty()) {
+      bucket = tuple.free_buckets.back();
+      tuple.free_buckets.pop_back();
+    }
+    else {
+      bucket = tuple.buckets.size();
+      tuple.buckets.emplace_back();
+    }
+    tuple.index.insert(key, bucket);
+  }
+  std::vector<Rule> &rules = tuple.buckets[bucket];
+  const Rule rule(priority, handle);
+  rules.insert(std::upper_bound(rules.begin(), rules.end(), rule), rule);
+
+  tuple.priorities.insert(priority);
+  if(tuple.best_priority != *tuple.priorities.begin() ||
+     tuple.priorities.size() == 1) {
+    tuple.best_priority = *tuple.priorities.begin();
+    if(!in_batch) sort_tuples();
+  }
+}
+
+void
+TupleSpaceClassifier::remove(handle_t handle, const ByteContainer &key,
+			     const ByteContainer &mask, int priority)
+{
+  assert(!in_batch);
+  auto it = tuples.find(mask);
+  assert(it != tuples.end());
+  Tuple &tuple = *it->second;
+
+  ExactMap::value_t bucket;
+  bool found = tuple.index.lookup(key, &bucket);
+  assert(found);
+  (void) found;
+  std::vector<Rule> &rules = tuple.buckets[bucket];
+  auto rule_it = std::lower_bound(rules.begin(), rules.end(),
+				  Rule(priority, handle));
+  assert(rule_it != rules.end() && rule_it->handle == handle);
+  rules.erase(rule_it);
+  if(rules.empty()) {
+    tuple.index.remove(key);
+    tuple.free_buckets.push_back(bucket);
+  }
+
+  tuple.priorities.erase(tuple.priorities.find(priority));
+  if(tuple.priorities.empty()) {
+    sorted_tuples.erase(std::find(sorted_tuples.begin(), sorted_tuples.end(),
+				  &tuple));
+    tuples.erase(it);
+  }
+  else if(tuple.best_priority != *tuple.priorities.begin()) {
+    tuple.best_priority = *tuple.priorities.begin();
+    sort_tuples();
+  }
+}
+
+bool
+TupleSpaceClassifier::lookup(const ByteContainer &key, handle_t *handle) const
+{
+  static thread_local ByteContainer masked_key;
+  masked_key.resize(nbytes_key);
+
+  const Rule *best = nullptr;
+  for(const Tuple *tuple : sorted_tuples) {
+    // the remaining tuples cannot do better
+    if(best && tuple->best_priority > best->priority) break;
+
+    for(size_t i = 0; i < nbytes_key; i++)
+      masked_key[i] = key[i] & tuple->mask[i];
+    ExactMap::value_t bucket;
+    if(!tuple->index.lookup(masked_key, &bucket)) continue;
+
+    const Rule &rule = tuple->buckets[bucket].front();
+    if(!best || rule < *best) best = &rule;
+  }
+
+  if(!best) return false;
+  *handle = best->handle;
+  return true;
+}
+
+void
+TupleSpaceClassifier::clear()
+{
+  sorted_tuples.clear();
+  tuples.clear();
+}
+
+void
+TupleSpaceClassifier::end_batch()
+{
+  in_batch = false;
+  sort_tuples();
+}
+
+void
+TupleSpaceClassifier::sort_tuples()
+{
+  std::sort(sorted_tuples.begin(), sorted_tuples.end(),
+	    [](const Tuple *t1, const Tuple *t2) {
+	      return t1->best_priority < t2->best_priority;
+	    });
+}
+
+namespace {
+
+#if defined(__AVX2__)
+const size_t words_per_vector = 4;
+#elif defined(__SSE2__)
+const size_t words_per_vector = 2;
+#else
+const size_t words_per_vector = 1;
+#endif
+
+}
+
+PackedScanClassifier::PackedScanClassifier(size_t nbytes_key)
+  : nbytes_key(nbytes_key)
+{
+  nwords = (nbytes_key + 7) / 8;
+  nwords = (nwords + words_per_vector - 1) / words_per_vector
+    * words_per_vector;
+}
+
+void
+PackedScanClassifier::pack(const ByteContainer &bytes, uint64_t *words) const
+{
+  std::fill(words, words + nwords, 0);
+  std::memcpy(words, bytes.data(), nbytes_key);
+}
+
+void
+PackedScanClassifier::insert(handle_t handle, const ByteContainer &key,
+			     const ByteContainer &mask, int priority)
+{
+  const Rule rule(priority, handle);
+  auto it = in_batch ? rules.end() :
+    std::upper_bound(rules.begin(), rules.end(), rule);
+  size_t pos = std::distance(rules.begin(), it);
+  rules.insert(it, rule);
+  rows.insert(rows.begin() + pos * 2 * nwords, 2 * nwords, 0);
+  uint64_t *row = rows.data() + pos * 2 * nwords;
+  pack(key, row);
+  pack(mask, row + nwords);
+}
+
+void
+PackedScanClassifier::remove(handle_t handle, const ByteContainer &key,
+			     const ByteContainer &mask, int priority)
+{
+  (void) key; (void) mask;
+  assert(!in_batch);
+  auto it = std::lower_bound(rules.begin(), rules.end(),
+			     Rule(priority, handle));
+  assert(it != rules.end() && it->handle == handle);
+  size_t pos = std::distance(rules.begin(), it);
+  rules.erase(it);
+  auto row_it = rows.begin() + pos * 2 * nwords;
+  rows.erase(row_it, row_it + 2 * nwords);
+}
+
+bool
+PackedScanClassifier::match_row(const uint64_t *key, const uint64_t *row) const
+{
+  const uint64_t *row_key = row;
+  const uint64_t *row_mask = row + nwords;
+#if defined(__AVX2__)
+  for(size_t i = 0; i < nwords; i += 4) {
+    __m256i k = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(key + i));
+    __m256i rk = _mm256_loadu_si256(
+      reinterpret_cast<const __m256i *>(row_key + i)
+    );
+    __m256i rm = _mm256_loadu_si256(
+      reinterpret_cast<const __m256i *>(row_mask + i)
+    );
+    __m256i diff = _mm256_xor_si256(_mm256_and_si256(k, rm), rk);
+    if(!_mm256_testz_si256(diff, diff)) return false;
+  }
+#elif defined(__SSE2__)
+  for(size_t i = 0; i < nwords; i += 2) {
+    __m128i k = _mm_loadu_si128(reinterpret_cast<const __m128i *>(key + i));
+    __m128i rk = _mm_loadu_si128(
+      reinterpret_cast<const __m128i *>(row_key + i)
+    );
+    __m128i rm = _mm_loadu_si128(
+      reinterpret_cast<const __m128i *>(row_mask + i)
+    );
+    __m128i eq = _mm_cmpeq_epi8(_mm_and_si128(k, rm), rk);
+    if(_mm_movemask_epi8(eq) != 0xffff) return false;
+  }
+#else
+  for(size_t i = 0; i < nwords; i++) {
+    if((key[i] & row_mask[i]) != row_key[i]) return false;
+  }
+#endif
+  return true;
+}
+
+bool
+PackedScanClassifier::lookup(const ByteContainer &key, handle_t *handle) const
+{
+  static thread_local std::vector<uint64_t> packed_key;
+  packed_key.resize(nwords);
+  pack(key, packed_key.data());
+
+  // the rules are sorted, so the first match is the best one
+  const size_t row_size = 2 * nwords;
+  const uint64_t *row = rows.data();
+  for(size_t pos = 0; pos < rules.size(); pos++, row += row_size) {
+    if(match_row(packed_key.data(), row)) {
+      *handle = rules[pos].handle;
+      return true;
+    }
+  }
+  return false;
+}
+
+void
+PackedScanClassifier::clear()
+{
+  rules.clear();
+  rows.clear();
+}
+
+void
+PackedScanClassifier::end_batch()
+{
+  in_batch = false;
+  std::vector<size_t> order(rules.size());
+  for(size_t i = 0; i < order.size(); i++) order[i] = i;
+  std::sort(order.begin(), order.end(), [this](size_t i, size_t j) {
+      return rules[i] < rules[j];
+    });
+
+  const size_t row_size = 2 * nwords;
+  std::vector<Rule> sorted_rules;
+  std::vector<uint64_t> sorted_rows(rows.size());
+  sorted_rules.reserve(rules.size());
+  for(size_t i = 0; i < order.size(); i++) {
+    sorted_rules.push_back(rules[order[i]]);
+    std::copy(rows.begin() + order[i] * row_size,
+	      rows.begin() + (order[i] + 1) * row_size,
+	      sorted_rows.begin() + i * row_size);
+  }
+  rules.swap(sorted_rules);
+  rows.swap(sorted_rows);
+}
@@ -0,0 +1,123 @@
+/* Copyright 2013-present Barefoot Networks, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Antonin Bas (antonin@barefootnetworks.com)
+ *
+ */
+
+#include <iostream>
+#include <sstream>
+#include <thread>
+#include <algorithm>
+
+#include <cstring>
+
+#include <sched.h>
+
+#include "bm_sim/thread_affinity.h"
+
+namespace {
+
+const size_t nb_roles = 5;
+
+// only written at startup, before the threads are created
+std::vector<int> role_cpus[nb_roles];
+
+const char *role_name(ThreadAffinity::Role role) {
+  switch(role) {
+  case ThreadAffinity::Role::INGRESS: return "ingress";
+  case ThreadAffinity::Role::EGRESS: return "egress";
+  case ThreadAffinity::Role::TRANSMIT: return "transmit";
+  case ThreadAffinity::Role::RX: return "rx";
+  case ThreadAffinity::Role::THRIFT: return "thrift";
+  }
+  return "";
+}
+
+}
+
+bool
+ThreadAffinity::parse_cpu_list(const std::string &str,
+			       std::vector<int> *cpus) {
+  cpus->clear();
+  // getline does not return an empty last item
+  if(str.empty() || str.back() == ',') return false;
+  std::istringstream stream(str);
+  std::string range;
+  while(std::getline(stream, range, ',')) {
+    int first, last;
+    size_t dash = range.find('-');
+    try {
+      size_t end;
+      first = std::stoi(range.substr(0, dash), &end);
+      if(end != std::min(dash, range.size())) return false;
+      last = first;
+      if(dash != std::string::npos) {
+	last = std::stoi(range.substr(dash + 1), &end);
+	if(end != range.size() - dash - 1) return false;
+      }
+    }
+    catch(...) {
+      return false;
+    }
+    if(first < 0 || last < first || last >= CPU_SETSIZE) return false;
+    for(int cpu = first; cpu <= last; cpu++) cpus->push_back(cpu);
+  }
+  return !cpus->empty();
+}
+
+void
+ThreadAffinity::set_cpus(Role role, const std::vector<int> &cpus) {
+  role_cpus[static_cast<size_t>(role)] = cpus;
+}
+
+bool
+ThreadAffinity::has_cpus(Role role) {
+  return !role_cpus[static_cast<size_t>(role)].empty();
+}
+
+void
+ThreadAffinity::pin_thread(pthread_t thread, Role role, int index) {
+  const std::vector<int> &cpus = role_cpus[static_cast<size_t>(role)];
+  if(cpus.empty()) return;
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  if(index == ANY) {
+    for(int cpu : cpus) CPU_SET(cpu, &set);
+  }
+  else {
+    CPU_SET(cpus[index % cpus.size()], &set);
+  }
+  int error = pthread_setaffinity_np(thread, sizeof(set), &set);
+  if(error != 0) {
+    std::cout << "Warning: cannot pin " << role_name(role) << " thread: "
+	      << strerror(error) << std::endl;
+  }
+}
+
+void
+ThreadAffinity::run_pinned(Role role, int index,
+			   const std::function<void()> &fn) {
+  if(!has_cpus(role)) {
+    fn();
+    return;
+  }
+  std::thread t([role, index, &fn]() {
+      pin_current_thread(role, index);
+      fn();
+    });
+  t.join();
+}
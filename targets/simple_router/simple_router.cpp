@@ -33,6 +33,7 @@
 #include "bm_sim/tables.h"
 #include "bm_sim/switch.h"
 #include "bm_sim/event_logger.h"
+#include "bm_sim/thread_affinity.h"
 
 #include "simple_router.h"
 #include "primitives.h"
@@ -77,6 +78,7 @@ private:
 };
 
 void SimpleSwitch::transmit_thread() {
+  ThreadAffinity::pin_current_thread(ThreadAffinity::Role::TRANSMIT);
   while(1) {
     std::unique_ptr<Packet> packet;
     output_buffer.pop_back(&packet);
@@ -87,6 +89,8 @@ void SimpleSwitch::transmit_thread() {
 }
 
 void SimpleSwitch::pipeline_thread() {
+  // the only thread running the pipeline
+  ThreadAffinity::pin_current_thread(ThreadAffinity::Role::INGRESS, 0);
   Pipeline *ingress_mau = this->get_pipeline("ingress");
   Pipeline *egress_mau = this->get_pipeline("egress");
   Parser *parser = this->get_parser("parser");
@@ -21,11 +21,16 @@
 #include <iostream>
 #include <fstream>
 #include <string>
+#include <random>
+#include <algorithm>
+
+#include <cassert>
 
 #include <unistd.h>
 
 #include "bm_sim/parser.h"
 #include "bm_sim/tables.h"
+#include "bm_sim/thread_affinity.h"
 
 #include "primitives.h"
 #include "simplelog.h"
@@ -39,12 +44,12 @@
 SimpleSwitch::SimpleSwitch(int max_port)
   : Switch(false), // enable_switch = false
     max_port(max_port),
-    input_buffer(1024), egress_buffers(max_port), output_buffer(128),
+    output_buffer(128),
     pre(new McSimplePreLAG()),
     start(clock::now()) {
-  for(int i = 0; i < max_port; i++) {
-    egress_buffers[i].set_capacity(64);
-  }
+  make_egress_ports(1);
+
+  input_buffers.emplace_back(new InputQueue(1024));
 
   add_component<McSimplePreLAG>(pre);
 
@@ -55,199 +60,558 @@ SimpleSwitch::SimpleSwitch(int max_port)
   add_required_field("standard_metadata", "clone_spec");
 }
 
+void SimpleSwitch::options_parsed() {
+  input_buffers.clear();
+  input_buffers.resize(get_nb_ingress_threads());
+  // each queue is allocated on the NUMA node of the thread which consumes it
+  for(int i = 0; i < get_nb_ingress_threads(); i++) {
+    ThreadAffinity::run_pinned(ThreadAffinity::Role::INGRESS, i, [this, i]() {
+	input_buffers[i].reset(new InputQueue(1024));
+      });
+  }
+  make_egress_ports(get_nb_priority_queues());
+}
+
+int SimpleSwitch::get_nb_egress_workers() const {
+  return std::min(get_nb_egress_threads(), max_port);
+}
+
+void SimpleSwitch::make_egress_ports(size_t nb_queues) {
+  egress_ports.clear();
+  egress_ports.resize(max_port);
+  // the queues of a port are allocated on the NUMA node of the egress thread
+  // the port is affine to
+  const int nb_egress_workers = get_nb_egress_workers();
+  for(int w = 0; w < nb_egress_workers; w++) {
+    ThreadAffinity::run_pinned(
+      ThreadAffinity::Role::EGRESS, w,
+      [this, w, nb_egress_workers, nb_queues]() {
+	for(int port = w; port < max_port; port += nb_egress_workers) {
+	  egress_ports[port].reset(new EgressPort(nb_queues));
+	  for(size_t p = 0; p < nb_queues; p++)
+	    egress_ports[port]->get_queue(p).set_capacity(64);
+	}
+      });
+  }
+}
+
 void SimpleSwitch::start_and_return() {
-  std::thread t1(&SimpleSwitch::ingress_thread, this);
-  t1.detach();
-  for(int i = 0; i < max_port; i++) {
+  parser = this->get_parser("parser");
+  ingress_mau = this->get_pipeline("ingress");
+  egress_mau = this->get_pipeline("egress");
+  deparser = this->get_deparser("deparser");
+
+  // enough packets to fill the input and output buffers, as well as one of the
+  // egress buffers; more will be allocated on demand if needed. Packets are
+  // allocated by the thread receiving them, so this is where they should be.
+  const size_t nb_prewarm =
+    input_buffers.size() * input_buffers[0]->get_capacity() +
+    output_buffer.get_capacity() +
+    egress_ports[0]->get_queue(0).get_capacity();
+  ThreadAffinity::run_pinned(ThreadAffinity::Role::RX, ThreadAffinity::ANY,
+			     [nb_prewarm]() { Packet::prewarm(nb_prewarm); });
+
+  // the egress pool needs to exist before the ingress threads push packets
+  const int nb_egress_workers = get_nb_egress_workers();
+  for(int i = 0; i < nb_egress_workers; i++)
+    egress_workers.emplace_back(new EgressWorker(max_port));
+  for(int port = 0; port < max_port; port++)
+    egress_workers[port % nb_egress_workers]->ports.push_back(port);
+  for(int i = 0; i < nb_egress_workers; i++)
+    egress_workers[i]->next_steal = i * max_port / nb_egress_workers;
+
+  for(size_t i = 0; i < input_buffers.size(); i++) {
+    std::thread t1(&SimpleSwitch::ingress_thread, this, i);
+    t1.detach();
+  }
+  for(int i = 0; i < nb_egress_workers; i++) {
     std::thread t2(&SimpleSwitch::egress_thread, this, i);
     t2.detach();
   }
   std::thread t3(&SimpleSwitch::transmit_thread, this);
   t3.detach();
+
+  started.store(true, std::memory_order_release);
+}
+
+void SimpleSwitch::transmit(const Packet &packet) {
+  ELOGGER->packet_out(packet);
+  SIMPLELOG << "transmitting packet " << packet.get_packet_id() << std::endl;
+  int port = packet.get_egress_port();
+  std::unique_lock<std::mutex> lock(egress_ports[port]->get_transmit_mutex());
+  transmit_fn(port, packet.data(), packet.get_data_size());
 }
 
 void SimpleSwitch::transmit_thread() {
+  ThreadAffinity::pin_current_thread(ThreadAffinity::Role::TRANSMIT);
+  PacketBatch packets;
+  packets.reserve(batch_size);
   while(1) {
-    std::unique_ptr<Packet> packet;
-    output_buffer.pop_back(&packet);
-    ELOGGER->packet_out(*packet);
-    SIMPLELOG << "transmitting packet " << packet->get_packet_id() << std::endl;
-    transmit_fn(packet->get_egress_port(), packet->data(), packet->get_data_size());
+    packets.clear();
+    output_buffer.pop_back_batch(&packets, batch_size);
+    for(const auto &packet : packets) {
+      transmit(*packet);
+      egress_ports[packet->get_egress_port()]->remove_in_flight(1);
+    }
   }
 }
 
-void SimpleSwitch::ingress_thread() {
-  Parser *parser = this->get_parser("parser");
-  Pipeline *ingress_mau = this->get_pipeline("ingress");
+namespace {
+
+// standard RSS key, for which hashing is well-spread
+const unsigned char rss_key[40] = {
+  0x6d, 0x5a, 0x56, 0xda, 0x25, 0x5b, 0x0e, 0xc2,
+  0x41, 0x67, 0x25, 0x3d, 0x43, 0xa3, 0x8f, 0xb0,
+  0xd0, 0xca, 0x2b, 0xcb, 0xae, 0x7b, 0x30, 0xb4,
+  0x77, 0xcb, 0x2d, 0xa3, 0x80, 0x30, 0xf2, 0x0c,
+  0x6a, 0x42, 0xb7, 0x3b, 0xbe, 0xac, 0x01, 0xfa
+};
+
+uint32_t toeplitz_hash(const unsigned char *data, size_t len) {
+  assert(len + 4 <= sizeof(rss_key));
+  uint32_t hash = 0;
+  uint32_t window = (rss_key[0] << 24) | (rss_key[1] << 16) |
+    (rss_key[2] << 8) | rss_key[3];
+  for(size_t i = 0; i < len; i++) {
+    for(int b = 7; b >= 0; b--) {
+      if(data[i] & (1 << b)) hash ^= window;
+      window <<= 1;
+      if(rss_key[i + 4] & (1 << b)) window |= 1;
+    }
+  }
+  return hash;
+}
 
-  PHV *phv;
+bool has_l4_ports(unsigned char proto) {
+  return proto == 6 || proto == 17 || proto == 132;  // TCP, UDP, SCTP
+}
 
-  while(1) {
-    std::unique_ptr<Packet> packet;
-    input_buffer.pop_back(&packet);
+}
 
-    phv = packet->get_phv();
+size_t SimpleSwitch::get_ingress_worker(int port_num,
+					const char *buffer, int len) const {
+  if(input_buffers.size() == 1) return 0;
+
+  // we look directly at the raw bytes, the parser has not run yet
+  const unsigned char *pkt = (const unsigned char *) buffer;
+  // the IP addresses, followed by the L4 ports if present
+  unsigned char tuple[36];
+  size_t tuple_len = 0;
+  int offset = 12;
+  while(offset + 2 <= len) {
+    uint16_t ethertype = (pkt[offset] << 8) | pkt[offset + 1];
+    offset += 2;
+    if(ethertype == 0x8100 || ethertype == 0x88a8) {  // VLAN tags
+      offset += 2;
+      continue;
+    }
+    const unsigned char *ip = pkt + offset;
+    int ip_len = len - offset;
+    const unsigned char *l4 = nullptr;
+    if(ethertype == 0x0800 && ip_len >= 20) {
+      std::copy(ip + 12, ip + 20, tuple);
+      tuple_len = 8;
+      int ihl = (ip[0] & 0x0f) * 4;
+      bool fragment = ((ip[6] & 0x3f) | ip[7]) != 0;
+      if(has_l4_ports(ip[9]) && !fragment && ip_len >= ihl + 4)
+	l4 = ip + ihl;
+    }
+    else if(ethertype == 0x86dd && ip_len >= 40) {
+      std::copy(ip + 8, ip + 40, tuple);
+      tuple_len = 32;
+      if(has_l4_ports(ip[6]) && ip_len >= 44)
+	l4 = ip + 40;
+    }
+    if(l4) {
+      std::copy(l4, l4 + 4, tuple + tuple_len);
+      tuple_len += 4;
+    }
+    break;
+  }
 
-    int ingress_port = packet->get_ingress_port();
-    SIMPLELOG << "processing packet " << packet->get_packet_id()
-	      << " received on port "<< ingress_port << std::endl;
+  // non-IP traffic is kept in order per ingress port
+  if(tuple_len == 0) return port_num % input_buffers.size();
+  return toeplitz_hash(tuple, tuple_len) % input_buffers.size();
+}
 
-    if(phv->has_field("intrinsic_metadata.ingress_global_timestamp")) {
-      phv->get_field("intrinsic_metadata.ingress_global_timestamp")
-        .set(duration_cast<microseconds>(clock::now() - start).count());
-    }
+packet_id_t SimpleSwitch::new_copy_id() {
+  static thread_local std::mt19937 gen(
+    std::hash<std::thread::id>()(std::this_thread::get_id())
+  );
+  static thread_local std::uniform_int_distribution<packet_id_t> copy_id_dis;
+  return copy_id_dis(gen);
+}
 
-    // setting standard metadata
-    phv->get_field("standard_metadata.ingress_port").set(ingress_port);
-    int ingress_length = packet->get_ingress_length();
-    phv->get_field("standard_metadata.packet_length").set(ingress_length);
-    Field &f_instance_type = phv->get_field("standard_metadata.instance_type");
-    f_instance_type.set(PKT_INSTANCE_TYPE_NORMAL);
+void SimpleSwitch::ingress_process(std::unique_ptr<Packet> packet,
+				   PacketBatch *to_egress) {
+  PHV *phv = packet->get_phv();
 
-    parser->parse(packet.get());
+  int ingress_port = packet->get_ingress_port();
+  SIMPLELOG << "processing packet " << packet->get_packet_id()
+	    << " received on port "<< ingress_port << std::endl;
 
-    ingress_mau->apply(packet.get());
+  if(phv->has_field("intrinsic_metadata.ingress_global_timestamp")) {
+    phv->get_field("intrinsic_metadata.ingress_global_timestamp")
+      .set(duration_cast<microseconds>(clock::now() - start).count());
+  }
 
-    Field &f_egress_spec = phv->get_field("standard_metadata.egress_spec");
-    int egress_spec = f_egress_spec.get_int();
+  // setting standard metadata
+  phv->get_field("standard_metadata.ingress_port").set(ingress_port);
+  int ingress_length = packet->get_ingress_length();
+  phv->get_field("standard_metadata.packet_length").set(ingress_length);
+  Field &f_instance_type = phv->get_field("standard_metadata.instance_type");
+  f_instance_type.set(PKT_INSTANCE_TYPE_NORMAL);
 
-    Field &f_clone_spec = phv->get_field("standard_metadata.clone_spec");
-    unsigned int clone_spec = f_clone_spec.get_uint();
+  parser->parse(packet.get());
 
-    int learn_id = 0;
-    unsigned int mgid = 0u;
+  ingress_mau->apply(packet.get());
 
-    if(phv->has_header("intrinsic_metadata")) {
-      Field &f_learn_id = phv->get_field("intrinsic_metadata.lf_field_list");
-      learn_id = f_learn_id.get_int();
+  Field &f_egress_spec = phv->get_field("standard_metadata.egress_spec");
+  int egress_spec = f_egress_spec.get_int();
 
-      Field &f_mgid = phv->get_field("intrinsic_metadata.mcast_grp");
-      mgid = f_mgid.get_uint();
-    }
+  Field &f_clone_spec = phv->get_field("standard_metadata.clone_spec");
+  unsigned int clone_spec = f_clone_spec.get_uint();
 
-    packet_id_t copy_id;
-    int egress_port;
-
-    // INGRESS CLONING
-    if(clone_spec) {
-      SIMPLELOG << "cloning packet at ingress" << std::endl;
-      egress_port = get_mirroring_mapping(clone_spec & 0xFFFF);
-      if(egress_port >= 0) {
-	f_instance_type.set(PKT_INSTANCE_TYPE_INGRESS_CLONE);
-	p4object_id_t field_list_id = clone_spec >> 16;
-	copy_id = copy_id_dis(gen);
-	std::unique_ptr<Packet> packet_copy(new Packet(packet->clone_and_reset_metadata(copy_id)));
-	PHV *phv_copy = packet_copy->get_phv();
-	FieldList *field_list = this->get_field_list(field_list_id);
-	for(const auto &p : *field_list) {
-	  phv_copy->get_field(p.first, p.second)
-	    .set(phv->get_field(p.first, p.second));
-	}
-	packet_copy->set_egress_port(egress_port);
-	egress_buffers[egress_port].push_front(std::move(packet_copy));
-	f_instance_type.set(PKT_INSTANCE_TYPE_NORMAL);
+  int learn_id = 0;
+  unsigned int mgid = 0u;
+
+  if(phv->has_header("intrinsic_metadata")) {
+    Field &f_learn_id = phv->get_field("intrinsic_metadata.lf_field_list");
+    learn_id = f_learn_id.get_int();
+
+    Field &f_mgid = phv->get_field("intrinsic_metadata.mcast_grp");
+    mgid = f_mgid.get_uint();
+  }
+
+  packet_id_t copy_id;
+  int egress_port;
+
+  // INGRESS CLONING
+  if(clone_spec) {
+    SIMPLELOG << "cloning packet at ingress" << std::endl;
+    egress_port = get_mirroring_mapping(clone_spec & 0xFFFF);
+    if(egress_port >= 0) {
+      f_instance_type.set(PKT_INSTANCE_TYPE_INGRESS_CLONE);
+      p4object_id_t field_list_id = clone_spec >> 16;
+      copy_id = new_copy_id();
+      std::unique_ptr<Packet> packet_copy(new Packet(packet->clone_and_reset_metadata(copy_id)));
+      PHV *phv_copy = packet_copy->get_phv();
+      FieldList *field_list = this->get_field_list(field_list_id);
+      for(const auto &p : *field_list) {
+	phv_copy->get_field(p.first, p.second)
+	  .set(phv->get_field(p.first, p.second));
       }
+      packet_copy->set_egress_port(egress_port);
+      to_egress->push_back(std::move(packet_copy));
+      f_instance_type.set(PKT_INSTANCE_TYPE_NORMAL);
+    }
+  }
+
+  // LEARNING
+  if(learn_id > 0) {
+    get_learn_engine()->learn(learn_id, *packet.get());
+  }
+
+  // MULTICAST
+  if(mgid != 0) {
+    SIMPLELOG << "multicast\n";
+    const auto pre_out = pre->replicate({mgid});
+    for(const auto &out : pre_out) {
+      egress_port = out.egress_port;
+      // if(ingress_port == egress_port) continue; // pruning
+      SIMPLELOG << "replicating packet out of port " << egress_port
+		<< std::endl;
+      copy_id = new_copy_id();
+      // the copies share the original PHV, only the headers they write to
+      // are copied
+      std::unique_ptr<Packet> packet_copy(
+	new Packet(packet->clone_cow(copy_id++))
+      );
+      PHV *phv_copy = packet_copy->get_phv();
+      phv_copy->get_field("intrinsic_metadata.egress_rid").set(out.rid);
+      phv_copy->get_field("standard_metadata.instance_type")
+	.set(PKT_INSTANCE_TYPE_REPLICATION);
+      packet_copy->set_egress_port(egress_port);
+      to_egress->push_back(std::move(packet_copy));
     }
-    
-    // LEARNING
-    if(learn_id > 0) {
-      get_learn_engine()->learn(learn_id, *packet.get());
+
+    // when doing multicast, we discard the original packet
+    return;
+  }
+
+  egress_port = egress_spec;
+  SIMPLELOG << "egress port is " << egress_port << std::endl;
+
+  if(egress_port == 511) {  // drop packet
+    SIMPLELOG << "dropping packet\n";
+    return;
+  }
+
+  packet->set_egress_port(egress_port);
+  to_egress->push_back(std::move(packet));
+}
+
+void SimpleSwitch::ingress_thread(size_t worker) {
+  ThreadAffinity::pin_current_thread(ThreadAffinity::Role::INGRESS, worker);
+  PacketBatch packets;
+  packets.reserve(batch_size);
+  PacketBatch to_egress;
+  // packets for each egress queue are pushed all at once, after the whole
+  // input batch has been processed
+  const size_t nb_queues = egress_ports[0]->get_nb_queues();
+  std::vector<PacketBatch> egress_batches(max_port * nb_queues);
+  std::vector<size_t> egress_queues_touched;
+
+  while(1) {
+    packets.clear();
+    input_buffers[worker]->pop_back_batch(&packets, batch_size);
+
+    for(auto &packet : packets) {
+      ingress_process(std::move(packet), &to_egress);
+      for(auto &out : to_egress) {
+	size_t q = out->get_egress_port() * nb_queues +
+	  get_egress_priority(*out);
+	if(egress_batches[q].empty()) egress_queues_touched.push_back(q);
+	egress_batches[q].push_back(std::move(out));
+      }
+      to_egress.clear();
     }
 
-    // MULTICAST
-    int instance_type = f_instance_type.get_int();
-    if(mgid != 0) {
-      SIMPLELOG << "multicast\n";
-      Field &f_rid = phv->get_field("intrinsic_metadata.egress_rid");
-      const auto pre_out = pre->replicate({mgid});
-      for(const auto &out : pre_out) {
-	egress_port = out.egress_port;
-	// if(ingress_port == egress_port) continue; // pruning
-	SIMPLELOG << "replicating packet out of port " << egress_port
-		  << std::endl;
-	f_rid.set(out.rid);
-	f_instance_type.set(PKT_INSTANCE_TYPE_REPLICATION);
-	copy_id = copy_id_dis(gen);
-	std::unique_ptr<Packet> packet_copy(new Packet(packet->clone(copy_id++)));
-	packet_copy->set_egress_port(egress_port);
-	egress_buffers[egress_port].push_front(std::move(packet_copy));
+    for(size_t q : egress_queues_touched)
+      enqueue_egress_batch(q / nb_queues, q % nb_queues, &egress_batches[q]);
+    egress_queues_touched.clear();
+  }
+}
+
+size_t SimpleSwitch::get_egress_priority(const Packet &packet) const {
+  const size_t nb_queues = egress_ports[0]->get_nb_queues();
+  if(nb_queues == 1) return 0;
+  const PHV *phv = packet.get_phv();
+  if(!phv->has_field("intrinsic_metadata.priority")) return 0;
+  unsigned int priority =
+    phv->get_field("intrinsic_metadata.priority").get_uint();
+  return std::min<size_t>(priority, nb_queues - 1);
+}
+
+// packets are counted in flight before being pushed, so that the count cannot
+// go down before it goes up
+void SimpleSwitch::enqueue_egress(int port, size_t priority,
+				  std::unique_ptr<Packet> packet) {
+  EgressPort &egress_port = *egress_ports[port];
+  egress_port.add_in_flight(1);
+  egress_port.get_queue(priority).push_front(std::move(packet));
+  // the packet is left to us if the queue is full
+  if(packet) egress_port.remove_in_flight(1);
+  notify_egress(port);
+}
+
+void SimpleSwitch::enqueue_egress_batch(int port, size_t priority,
+					PacketBatch *packets) {
+  EgressPort &egress_port = *egress_ports[port];
+  const size_t nb_packets = packets->size();
+  egress_port.add_in_flight(nb_packets);
+  size_t pushed = egress_port.get_queue(priority).push_front_batch(packets);
+  if(pushed < nb_packets) egress_port.remove_in_flight(nb_packets - pushed);
+  notify_egress(port);
+}
+
+void SimpleSwitch::notify_egress(int port) {
+  // pairs with the fence in egress_sleep(): either the worker sees the new
+  // packets when it checks the queues one last time, or we see it sleeping
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  EgressWorker *worker = egress_workers[port % egress_workers.size()].get();
+  if(!worker->sleeping.load(std::memory_order_relaxed)) {
+    // the worker for this port is busy, wake up an idle one to steal the work
+    worker = nullptr;
+    for(const auto &w : egress_workers) {
+      if(w->sleeping.load(std::memory_order_relaxed)) {
+	worker = w.get();
+	break;
       }
-      f_instance_type.set(instance_type);
+    }
+    if(!worker) return;
+  }
+  std::unique_lock<std::mutex> lock(worker->mutex);
+  worker->signaled = true;
+  worker->cv.notify_one();
+}
 
-      // when doing multicast, we discard the original packet
-      continue;
+bool SimpleSwitch::egress_try_service(EgressWorker *worker, int port,
+				      PacketBatch *packets) {
+  EgressPort &egress_port = *egress_ports[port];
+  if(egress_port.empty() || !egress_port.try_claim()) return false;
+  clock::time_point wake_at = clock::time_point::max();
+  if(egress_port.pop_back_batch(packets, batch_size, &wake_at) > 0) return true;
+  egress_port.release();
+  // rate limited, we will need to come back later
+  if(wake_at < worker->timer_at[port]) {
+    worker->timer_at[port] = wake_at;
+    worker->timers.schedule(wake_at, port);
+  }
+  return false;
+}
+
+int SimpleSwitch::egress_next_batch(EgressWorker *worker,
+				    PacketBatch *packets) {
+  while(1) {
+    worker->timers.advance(clock::now(), [worker](int port) {
+	worker->timer_at[port] = clock::time_point::max();
+      });
+    const size_t nb_ports = worker->ports.size();
+    for(size_t i = 0; i < nb_ports; i++) {
+      int port = worker->ports[worker->next_port];
+      worker->next_port = (worker->next_port + 1) % nb_ports;
+      if(egress_try_service(worker, port, packets)) return port;
+    }
+    for(int i = 0; i < max_port; i++) {
+      int port = worker->next_steal;
+      worker->next_steal = (worker->next_steal + 1) % max_port;
+      if(egress_try_service(worker, port, packets)) return port;
     }
+    egress_sleep(worker, worker->timers.next_expiry());
+  }
+}
+
+void SimpleSwitch::egress_sleep(EgressWorker *worker,
+				clock::time_point wake_at) {
+  std::unique_lock<std::mutex> lock(worker->mutex);
+  worker->sleeping.store(true, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  // packets may have been pushed since we looked at the queues
+  clock::time_point now = clock::now();
+  for(int port = 0; port < max_port; port++) {
+    const EgressPort &egress_port = *egress_ports[port];
+    if(!egress_port.is_claimed() && egress_port.ready(now)) {
+      worker->sleeping.store(false, std::memory_order_relaxed);
+      return;
+    }
+  }
+  auto signaled = [worker]() { return worker->signaled; };
+  if(wake_at == clock::time_point::max())
+    worker->cv.wait(lock, signaled);
+  else
+    worker->cv.wait_until(lock, wake_at, signaled);
+  worker->signaled = false;
+  worker->sleeping.store(false, std::memory_order_relaxed);
+}
 
-    egress_port = egress_spec;
-    SIMPLELOG << "egress port is " << egress_port << std::endl;    
+bool SimpleSwitch::egress_process(Packet *packet, PacketBatch *clones) {
+  PHV *phv = packet->get_phv();
 
-    if(egress_port == 511) {  // drop packet
-      SIMPLELOG << "dropping packet\n";
-      continue;
+  int egress_port = packet->get_egress_port();
+  phv->get_field("standard_metadata.egress_port").set(egress_port);
+
+  Field &f_egress_spec = phv->get_field("standard_metadata.egress_spec");
+  f_egress_spec.set(0);
+
+  egress_mau->apply(packet);
+
+  Field &f_instance_type = phv->get_field("standard_metadata.instance_type");
+
+  Field &f_clone_spec = phv->get_field("standard_metadata.clone_spec");
+  unsigned int clone_spec = f_clone_spec.get_uint();
+
+  packet_id_t copy_id;
+
+  // EGRESS CLONING
+  if(clone_spec) {
+    SIMPLELOG << "cloning packet at egress" << std::endl;
+    egress_port = get_mirroring_mapping(clone_spec & 0xFFFF);
+    if(egress_port >= 0) {
+      f_instance_type.set(PKT_INSTANCE_TYPE_EGRESS_CLONE);
+      p4object_id_t field_list_id = clone_spec >> 16;
+      copy_id = new_copy_id();
+      std::unique_ptr<Packet> packet_copy(new Packet(packet->clone_and_reset_metadata(copy_id++)));
+      PHV *phv_copy = packet_copy->get_phv();
+      FieldList *field_list = this->get_field_list(field_list_id);
+      for(const auto &p : *field_list) {
+	phv_copy->get_field(p.first, p.second)
+	  .set(phv->get_field(p.first, p.second));
+      }
+      packet_copy->set_egress_port(egress_port);
+      clones->push_back(std::move(packet_copy));
+      f_instance_type.set(PKT_INSTANCE_TYPE_NORMAL);
     }
+  }
 
-    packet->set_egress_port(egress_port);
-    egress_buffers[egress_port].push_front(std::move(packet));
+  // TODO: should not be done like this in egress pipeline
+  int egress_spec = f_egress_spec.get_int();
+  if(egress_spec == 511) {  // drop packet
+    SIMPLELOG << "dropping packet\n";
+    return false;
   }
+
+  deparser->deparse(packet);
+  return true;
 }
 
-void SimpleSwitch::egress_thread(int port) {
-  Deparser *deparser = this->get_deparser("deparser");
-  Pipeline *egress_mau = this->get_pipeline("egress");
-  PHV *phv;
+void SimpleSwitch::egress_thread(size_t worker_id) {
+  ThreadAffinity::pin_current_thread(ThreadAffinity::Role::EGRESS, worker_id);
+  EgressWorker *worker = egress_workers[worker_id].get();
+
+  PacketBatch packets;
+  packets.reserve(batch_size);
+  PacketBatch to_transmit;
+  to_transmit.reserve(batch_size);
+  PacketBatch clones;
 
   while(1) {
-    std::unique_ptr<Packet> packet;
-    egress_buffers[port].pop_back(&packet);
-    phv = packet->get_phv();
-
-    int egress_port = packet->get_egress_port();
-    phv->get_field("standard_metadata.egress_port").set(egress_port);
-
-    Field &f_egress_spec = phv->get_field("standard_metadata.egress_spec");
-    f_egress_spec.set(0);
-
-    egress_mau->apply(packet.get());
-
-    Field &f_instance_type = phv->get_field("standard_metadata.instance_type");
-
-    Field &f_clone_spec = phv->get_field("standard_metadata.clone_spec");
-    unsigned int clone_spec = f_clone_spec.get_uint();
-
-    packet_id_t copy_id;
-
-    // EGRESS CLONING
-    if(clone_spec) {
-      SIMPLELOG << "cloning packet at egress" << std::endl;
-      egress_port = get_mirroring_mapping(clone_spec & 0xFFFF);
-      if(egress_port >= 0) {
-	f_instance_type.set(PKT_INSTANCE_TYPE_EGRESS_CLONE);
-	p4object_id_t field_list_id = clone_spec >> 16;
-	copy_id = copy_id_dis(gen);
-	std::unique_ptr<Packet> packet_copy(new Packet(packet->clone_and_reset_metadata(copy_id++)));
-	PHV *phv_copy = packet_copy->get_phv();
-	FieldList *field_list = this->get_field_list(field_list_id);
-	for(const auto &p : *field_list) {
-	  phv_copy->get_field(p.first, p.second)
-	    .set(phv->get_field(p.first, p.second));
-	}
-	packet_copy->set_egress_port(egress_port);
-	egress_buffers[egress_port].push_front(std::move(packet_copy));
-	f_instance_type.set(PKT_INSTANCE_TYPE_NORMAL);
+    packets.clear();
+    int port = egress_next_batch(worker, &packets);
+    EgressPort &egress_port = *egress_ports[port];
+
+    for(auto &packet : packets) {
+      bool transmit = egress_process(packet.get(), &clones);
+      for(auto &clone : clones) {
+	int clone_port = clone->get_egress_port();
+	enqueue_egress(clone_port, get_egress_priority(*clone),
+		       std::move(clone));
       }
+      clones.clear();
+      if(transmit)
+	to_transmit.push_back(std::move(packet));
+      else
+	egress_port.remove_in_flight(1);
     }
 
-    // TODO: should not be done like this in egress pipeline
-    int egress_spec = f_egress_spec.get_int();
-    if(egress_spec == 511) {  // drop packet
-      SIMPLELOG << "dropping packet\n";
+    output_buffer.push_front_batch(&to_transmit);
+    // only now, so that the packets of a port cannot be reordered
+    egress_port.release();
+  }
+}
+
+void SimpleSwitch::process_to_completion(std::unique_ptr<Packet> packet) {
+  // packets are appended as we go: clones and replicas made in ingress, then
+  // clones made in egress
+  static thread_local PacketBatch to_egress;
+  ingress_process(std::move(packet), &to_egress);
+  for(size_t i = 0; i < to_egress.size(); i++) {
+    std::unique_ptr<Packet> out(std::move(to_egress[i]));
+    int port = out->get_egress_port();
+    EgressPort &egress_port = *egress_ports[port];
+    // shaped packets go through the queues, and so do the packets of a port
+    // which still has some in flight, so that they are not reordered; the
+    // claim keeps the egress threads (and the other receiving threads) away
+    // from the port until the packet is sent
+    if(egress_port.is_shaped() || egress_port.get_in_flight() > 0 ||
+       !egress_port.try_claim()) {
+      enqueue_egress(port, get_egress_priority(*out), std::move(out));
       continue;
     }
-
-    deparser->deparse(packet.get());
-
-    output_buffer.push_front(std::move(packet));
+    // some may have been queued, or a rate set, just before we claimed the port
+    if(egress_port.get_in_flight() > 0 || egress_port.is_shaped()) {
+      egress_port.release();
+      enqueue_egress(port, get_egress_priority(*out), std::move(out));
+      continue;
+    }
+    if(egress_process(out.get(), &to_egress)) transmit(*out);
+    egress_port.release();
+    // packets queued while we held the port may have been missed by the
+    // egress threads; pairs with the fence in notify_egress()
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if(!egress_port.empty()) notify_egress(port);
   }
+  to_egress.clear();
 }
 
 /* Switch instance */
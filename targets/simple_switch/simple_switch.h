@@ -24,8 +24,14 @@
 #include <memory>
 #include <chrono>
 #include <thread>
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
 
 #include "bm_sim/queue.h"
+#include "bm_sim/token_bucket.h"
+#include "bm_sim/timer_wheel.h"
 #include "bm_sim/packet.h"
 #include "bm_sim/switch.h"
 #include "bm_sim/event_logger.h"
@@ -33,40 +39,271 @@
 
 using std::chrono::microseconds;
 using std::chrono::duration_cast;
-using ticks = std::chrono::nanoseconds;
 
-class PacketQueue : public Queue<std::unique_ptr<Packet> >
+// the ingress threads and the egress threads (when cloning) push to the egress
+// queues, only the egress thread which has claimed the port pops
+typedef RingQueue<std::unique_ptr<Packet>, RingQueuePolicy::MPSC>
+  EgressRingQueue;
+
+// rates are enforced by try_pop_back_batch(), which never blocks; the blocking
+// pops of the base class ignore them; like the pops, the rates can only be
+// changed by the thread which has claimed the port
+class PacketQueue : public EgressRingQueue
 {
 private:
   typedef std::chrono::high_resolution_clock clock;
 
+public:
+  // the ring is allocated once, its depth can be lowered but not raised
+  static const size_t max_depth = 1024;
+
 public:
   PacketQueue()
-    : Queue<std::unique_ptr<Packet> >(1024, WriteReturn, ReadBlock),
-      last_sent(clock::now()), pkt_delay_ticks(0) { }
+    : EgressRingQueue(max_depth, WriteReturn, ReadBlock) { }
 
   void set_queue_rate(const uint64_t pps) {
-    using std::chrono::duration;
-    if(pps == 0) {
-      pkt_delay_ticks = ticks::zero();
-      return;
+    shaper.set_packet_rate(pps);
+  }
+
+  void set_queue_byte_rate(const uint64_t bytes_per_sec,
+			   const uint64_t burst_bytes) {
+    shaper.set_byte_rate(bytes_per_sec, burst_bytes);
+  }
+
+  bool is_shaped() const {
+    return shaper.is_enabled();
+  }
+
+  // only returns the packets the rates allow right now, see next_departure()
+  size_t try_pop_back_batch(std::vector<std::unique_ptr<Packet> > *pkts,
+			    size_t max) {
+    if(!shaper.is_enabled())
+      return EgressRingQueue::try_pop_back_batch(pkts, max);
+    clock::time_point now = clock::now();
+    size_t n = 0;
+    while(n < max && shaper.ready(now) &&
+	  EgressRingQueue::try_pop_back_batch(pkts, 1) > 0) {
+      shaper.consume(now, pkts->back()->get_ingress_length());
+      n++;
+    }
+    return n;
+  }
+
+  clock::time_point next_departure() const {
+    return shaper.next_departure();
+  }
+
+  // true if try_pop_back_batch() would return packets
+  bool ready(clock::time_point now) const {
+    return !empty() && shaper.ready(now);
+  }
+
+private:
+  Shaper shaper{};
+};
+
+// the priority queues of an egress port, queue i holding the packets of
+// priority i; the scheduler decides which queue is served next, within the
+// rate of the port
+class EgressPort
+{
+private:
+  typedef std::chrono::high_resolution_clock clock;
+  typedef std::vector<std::unique_ptr<Packet> > PacketBatch;
+
+public:
+  enum class SchedulerMode { STRICT_PRIORITY, WRR, DWRR };
+
+  // bytes credited to a DWRR queue each round, for a weight of 1
+  static const int64_t dwrr_quantum = 1500;
+
+public:
+  explicit EgressPort(size_t nb_queues)
+    : queues(nb_queues), weights(nb_queues), credits(nb_queues, 0) {
+    for(auto &weight : weights) weight.store(1, std::memory_order_relaxed);
+  }
+
+  size_t get_nb_queues() const { return queues.size(); }
+
+  PacketQueue &get_queue(size_t priority) { return queues[priority]; }
+
+  void set_scheduler_mode(SchedulerMode new_mode) {
+    mode.store(new_mode, std::memory_order_relaxed);
+  }
+
+  void set_port_rate(const uint64_t pps) {
+    shaper.set_packet_rate(pps);
+  }
+
+  void set_port_byte_rate(const uint64_t bytes_per_sec,
+			  const uint64_t burst_bytes) {
+    shaper.set_byte_rate(bytes_per_sec, burst_bytes);
+  }
+
+  // packets per round with WRR, multiple of dwrr_quantum with DWRR
+  void set_queue_weight(size_t priority, uint32_t weight) {
+    weights[priority].store(weight, std::memory_order_relaxed);
+  }
+
+  // does not block; pops up to max packets from the queue chosen by the
+  // scheduler, or returns 0 if no packet is ready, in which case wake_at is
+  // lowered to the next departure time allowed by the rates
+  size_t pop_back_batch(PacketBatch *pkts, size_t max,
+			clock::time_point *wake_at) {
+    clock::time_point now = clock::now();
+    if(!shaper.is_enabled()) return schedule(pkts, max, now, wake_at);
+    // one packet at a time, so that the port rate is checked for each of them
+    size_t n = 0;
+    while(n < max && shaper.ready(now) && schedule(pkts, 1, now, wake_at)) {
+      shaper.consume(now, pkts->back()->get_ingress_length());
+      n++;
+    }
+    if(n == 0 && !shaper.ready(now))
+      *wake_at = std::min(*wake_at, shaper.next_departure());
+    return n;
+  }
+
+  // true if the port or one of its queues has a rate
+  bool is_shaped() const {
+    if(shaper.is_enabled()) return true;
+    for(const auto &queue : queues)
+      if(queue.is_shaped()) return true;
+    return false;
+  }
+
+  bool empty() const {
+    for(const auto &queue : queues)
+      if(!queue.empty()) return false;
+    return true;
+  }
+
+  // true if pop_back_batch() would return packets
+  bool ready(clock::time_point now) const {
+    if(!shaper.ready(now)) return false;
+    for(const auto &queue : queues)
+      if(queue.ready(now)) return true;
+    return false;
+  }
+
+  // only one egress thread at a time can service the port
+  bool try_claim() {
+    return !claimed.exchange(true, std::memory_order_acquire);
+  }
+
+  void release() {
+    claimed.store(false, std::memory_order_release);
+  }
+
+  bool is_claimed() const {
+    return claimed.load(std::memory_order_relaxed);
+  }
+
+  // packets of the port which are queued, being processed by an egress thread
+  // or waiting in the output buffer, i.e. which have not been transmitted yet
+  void add_in_flight(size_t n) {
+    in_flight.fetch_add(n, std::memory_order_relaxed);
+  }
+
+  void remove_in_flight(size_t n) {
+    in_flight.fetch_sub(n, std::memory_order_release);
+  }
+
+  size_t get_in_flight() const {
+    return in_flight.load(std::memory_order_acquire);
+  }
+
+  // held while sending a packet on the port, which the transmit thread and the
+  // run-to-completion threads can both do
+  std::mutex &get_transmit_mutex() { return transmit_mutex; }
+
+  EgressPort(const EgressPort &) = delete;
+  EgressPort &operator =(const EgressPort &) = delete;
+
+private:
+  size_t schedule(PacketBatch *pkts, size_t max, clock::time_point now,
+		  clock::time_point *wake_at) {
+    switch(mode.load(std::memory_order_relaxed)) {
+    case SchedulerMode::WRR:
+      return pop_round_robin(pkts, max, now, wake_at, false);
+    case SchedulerMode::DWRR:
+      return pop_round_robin(pkts, max, now, wake_at, true);
+    default:
+      return pop_strict_priority(pkts, max, now, wake_at);
     }
-    queue_rate_pps = pps;
-    pkt_delay_ticks = duration_cast<ticks>(duration<double>(1. / pps));
   }
 
-  void pop_back(std::unique_ptr<Packet> *pkt) {
-    Queue<std::unique_ptr<Packet> >::pop_back(pkt);
-    // enforce rate
-    clock::time_point next_send = last_sent + pkt_delay_ticks;
-    std::this_thread::sleep_until(next_send);
-    last_sent = clock::now();
+  size_t pop_strict_priority(PacketBatch *pkts, size_t max,
+			     clock::time_point now,
+			     clock::time_point *wake_at) {
+    for(size_t i = queues.size(); i-- > 0; ) {
+      PacketQueue &queue = queues[i];
+      if(queue.ready(now)) return queue.try_pop_back_batch(pkts, max);
+      if(!queue.empty())
+	*wake_at = std::min(*wake_at, queue.next_departure());
+    }
+    return 0;
+  }
+
+  // with by_bytes, the credit of a queue is a deficit counter in bytes (DWRR),
+  // otherwise it is a number of packets (WRR)
+  size_t pop_round_robin(PacketBatch *pkts, size_t max,
+			 clock::time_point now, clock::time_point *wake_at,
+			 bool by_bytes) {
+    const size_t nb_queues = queues.size();
+    // the turn of the current queue may have started in a previous call, so
+    // we may need to come back to it
+    for(size_t i = 0; i <= nb_queues; i++) {
+      PacketQueue &queue = queues[current];
+      int64_t &credit = credits[current];
+      if(!queue.ready(now)) {
+	if(!queue.empty())
+	  *wake_at = std::min(*wake_at, queue.next_departure());
+	else if(by_bytes)
+	  credit = std::min<int64_t>(credit, 0);
+	end_turn();
+	continue;
+      }
+      if(!in_turn) {
+	int64_t weight = weights[current].load(std::memory_order_relaxed);
+	credit = by_bytes ? credit + weight * dwrr_quantum : weight;
+	in_turn = true;
+      }
+      size_t n = 0;
+      if(by_bytes) {
+	// the last packet can overdraw the credit, the debt is paid next round
+	while(n < max && credit > 0 && queue.try_pop_back_batch(pkts, 1) > 0) {
+	  credit -= pkts->back()->get_ingress_length();
+	  n++;
+	}
+	if(queue.empty()) credit = std::min<int64_t>(credit, 0);
+      }
+      else {
+	n = queue.try_pop_back_batch(pkts, std::min<int64_t>(max, credit));
+	credit -= n;
+      }
+      if(credit <= 0 || !queue.ready(now)) end_turn();
+      if(n > 0) return n;
+    }
+    return 0;
+  }
+
+  void end_turn() {
+    current = (current + 1) % queues.size();
+    in_turn = false;
   }
 
 private:
-  uint64_t queue_rate_pps;
-  clock::time_point last_sent;
-  ticks pkt_delay_ticks{};
+  std::vector<PacketQueue> queues;
+  std::atomic<SchedulerMode> mode{SchedulerMode::STRICT_PRIORITY};
+  std::vector<std::atomic<uint32_t> > weights;
+  Shaper shaper{};
+  // only accessed by the egress thread which has claimed the port
+  std::vector<int64_t> credits;
+  size_t current{0};
+  bool in_turn{false};
+  std::atomic<bool> claimed{false};
+  std::atomic<size_t> in_flight{0};
+  std::mutex transmit_mutex{};
 };
 
 class SimpleSwitch : public Switch {
@@ -91,7 +328,15 @@ public:
     // it is also part of the original P4 spec
     packet->get_phv()->reset_metadata();
 
-    input_buffer.push_front(std::unique_ptr<Packet>(packet));
+    // packets received before the switch is started are queued, they will be
+    // processed by the ingress threads
+    if(is_run_to_completion() && started.load(std::memory_order_acquire)) {
+      process_to_completion(std::unique_ptr<Packet>(packet));
+      return 0;
+    }
+
+    size_t worker = get_ingress_worker(port_num, buffer, len);
+    input_buffers[worker]->push_front(std::unique_ptr<Packet>(packet));
     return 0;
   }
 
@@ -106,20 +351,88 @@ public:
     return mirroring_map.erase(mirror_id);
   }
 
+  // returns 1 if the depth is more than PacketQueue::max_depth
   int set_egress_queue_depth(const size_t depth_pkts) {
+    if(depth_pkts > PacketQueue::max_depth) return 1;
     for(int i = 0; i < max_port; i++) {
-      egress_buffers[i].set_capacity(depth_pkts);
+      for(size_t p = 0; p < egress_ports[i]->get_nb_queues(); p++)
+	egress_ports[i]->get_queue(p).set_capacity(depth_pkts);
     }
     return 0;
   }
 
   int set_egress_queue_rate(const uint64_t rate_pps) {
     for(int i = 0; i < max_port; i++) {
-      egress_buffers[i].set_queue_rate(rate_pps);
+      update_egress_port(i, [rate_pps](EgressPort *egress_port) {
+	  for(size_t p = 0; p < egress_port->get_nb_queues(); p++)
+	    egress_port->get_queue(p).set_queue_rate(rate_pps);
+	});
     }
     return 0;
   }
 
+  // the following return 1 if the port or the priority is invalid
+
+  // also returns 1 if the depth is more than PacketQueue::max_depth
+  int set_egress_priority_queue_depth(int port, size_t priority,
+				      const size_t depth_pkts) {
+    if(!valid_egress_queue(port, priority)) return 1;
+    if(depth_pkts > PacketQueue::max_depth) return 1;
+    egress_ports[port]->get_queue(priority).set_capacity(depth_pkts);
+    return 0;
+  }
+
+  int set_egress_priority_queue_rate(int port, size_t priority,
+				     const uint64_t rate_pps) {
+    if(!valid_egress_queue(port, priority)) return 1;
+    update_egress_port(port, [priority, rate_pps](EgressPort *egress_port) {
+	egress_port->get_queue(priority).set_queue_rate(rate_pps);
+      });
+    return 0;
+  }
+
+  int set_egress_priority_queue_byte_rate(int port, size_t priority,
+					  const uint64_t bytes_per_sec,
+					  const uint64_t burst_bytes) {
+    if(!valid_egress_queue(port, priority)) return 1;
+    update_egress_port(port, [=](EgressPort *egress_port) {
+	egress_port->get_queue(priority)
+	  .set_queue_byte_rate(bytes_per_sec, burst_bytes);
+      });
+    return 0;
+  }
+
+  // the port rates apply to all the queues of the port together
+
+  int set_egress_port_rate(int port, const uint64_t rate_pps) {
+    if(!valid_egress_queue(port, 0)) return 1;
+    update_egress_port(port, [rate_pps](EgressPort *egress_port) {
+	egress_port->set_port_rate(rate_pps);
+      });
+    return 0;
+  }
+
+  int set_egress_port_byte_rate(int port, const uint64_t bytes_per_sec,
+				const uint64_t burst_bytes) {
+    if(!valid_egress_queue(port, 0)) return 1;
+    update_egress_port(port, [=](EgressPort *egress_port) {
+	egress_port->set_port_byte_rate(bytes_per_sec, burst_bytes);
+      });
+    return 0;
+  }
+
+  int set_egress_scheduler(int port, EgressPort::SchedulerMode mode) {
+    if(!valid_egress_queue(port, 0)) return 1;
+    egress_ports[port]->set_scheduler_mode(mode);
+    return 0;
+  }
+
+  int set_egress_queue_weight(int port, size_t priority, uint32_t weight) {
+    if(!valid_egress_queue(port, priority) || weight == 0) return 1;
+    egress_ports[port]->set_queue_weight(priority, weight);
+    return 0;
+  }
+
 private:
   enum PktInstanceType {
     PKT_INSTANCE_TYPE_NORMAL,
@@ -132,10 +445,97 @@ private:
   };
 
 private:
-  void ingress_thread();
-  void egress_thread(int port);
+  typedef std::vector<std::unique_ptr<Packet> > PacketBatch;
+  typedef RingQueue<std::unique_ptr<Packet>, RingQueuePolicy::MPSC> InputQueue;
+
+  // maximum number of packets moved at once between the threads
+  static const size_t batch_size = 32;
+
+  // a thread of the egress pool; it services the queues of the ports it is
+  // affine to first, and steals work from the other ports when it has nothing
+  // to do
+  struct EgressWorker {
+    explicit EgressWorker(int max_port)
+      : timer_at(max_port, clock::time_point::max()) { }
+
+    std::vector<int> ports{};
+    size_t next_port{0};
+    int next_steal{0};
+
+    // when the rates hold back the packets of a port, a timer is set for the
+    // time they can leave, and the worker sleeps until the first one
+    TimerWheel<int> timers{microseconds(1)};
+    std::vector<clock::time_point> timer_at;
+
+    std::atomic<bool> sleeping{false};
+    bool signaled{false};
+    std::mutex mutex{};
+    std::condition_variable cv{};
+  };
+
+private:
+  void options_parsed() override;
+
+  bool has_threading_options() const override { return true; }
+
+  // packets of the same flow always go to the same ingress thread
+  size_t get_ingress_worker(int port_num, const char *buffer, int len) const;
+
+  packet_id_t new_copy_id();
+
+  // the ingress pipeline, appends the packets to send to egress (clones,
+  // replicas, or the packet itself) to to_egress, with their egress port set
+  void ingress_process(std::unique_ptr<Packet> packet, PacketBatch *to_egress);
+  // the egress pipeline and the deparser, appends egress clones to clones;
+  // returns false if the packet is dropped
+  bool egress_process(Packet *packet, PacketBatch *clones);
+  void transmit(const Packet &packet);
+
+  void ingress_thread(size_t worker);
+  void egress_thread(size_t worker_id);
   void transmit_thread();
 
+  // with --run-to-completion, the receiving thread does it all, unless the
+  // port is shaped or still has packets in flight, in which case the packet
+  // goes through the egress queues
+  void process_to_completion(std::unique_ptr<Packet> packet);
+
+  int get_nb_egress_workers() const;
+  void make_egress_ports(size_t nb_queues);
+
+  bool valid_egress_queue(int port, size_t priority) const {
+    return port >= 0 && port < max_port &&
+      priority < egress_ports[port]->get_nb_queues();
+  }
+
+  // read from intrinsic_metadata.priority, if the P4 program has it
+  size_t get_egress_priority(const Packet &packet) const;
+
+  // push packets to an egress queue and make sure an egress thread notices
+  void enqueue_egress(int port, size_t priority,
+		      std::unique_ptr<Packet> packet);
+  void enqueue_egress_batch(int port, size_t priority, PacketBatch *packets);
+  void notify_egress(int port);
+
+  // the rates belong to the thread which has claimed the port, so they are
+  // changed under the claim; the port is then notified, as a worker may be
+  // sleeping until a departure time computed with the old rates
+  template <typename F>
+  void update_egress_port(int port, F update) {
+    EgressPort &egress_port = *egress_ports[port];
+    while(!egress_port.try_claim()) std::this_thread::yield();
+    update(&egress_port);
+    egress_port.release();
+    notify_egress(port);
+  }
+
+  // claims an egress port with packets ready and pops a batch from it; sleeps
+  // if there is no work; returns the port, which needs to be released
+  int egress_next_batch(EgressWorker *worker, PacketBatch *packets);
+  bool egress_try_service(EgressWorker *worker, int port,
+			  PacketBatch *packets);
+  void egress_sleep(EgressWorker *worker, clock::time_point wake_at);
+
   int get_mirroring_mapping(mirror_id_t mirror_id) const {
     const auto it = mirroring_map.find(mirror_id);
     if(it == mirroring_map.end()) return -1;
@@ -144,14 +544,19 @@ private:
 
 private:
   int max_port;
-  Queue<std::unique_ptr<Packet> > input_buffer;
-  std::vector<PacketQueue> egress_buffers{};
-  Queue<std::unique_ptr<Packet> > output_buffer;
+  // one per ingress thread
+  std::vector<std::unique_ptr<InputQueue> > input_buffers{};
+  std::vector<std::unique_ptr<EgressPort> > egress_ports{};
+  std::vector<std::unique_ptr<EgressWorker> > egress_workers{};
+  RingQueue<std::unique_ptr<Packet>, RingQueuePolicy::MPSC> output_buffer;
   std::shared_ptr<McSimplePreLAG> pre;
   clock::time_point start;
+  std::atomic<bool> started{false};
+  Parser *parser{nullptr};
+  Pipeline *ingress_mau{nullptr};
+  Pipeline *egress_mau{nullptr};
+  Deparser *deparser{nullptr};
   std::unordered_map<mirror_id_t, int> mirroring_map;
-  std::mt19937 gen;
-  std::uniform_int_distribution<packet_id_t> copy_id_dis{};
 };
 
 #endif
@@ -6,6 +6,7 @@ _THIS_DIR = os.path.dirname(os.path.realpath(__file__))
 sys.path.append(os.path.join(_THIS_DIR, "gen-py"))
 
 from sswitch_runtime import SimpleSwitch
+from sswitch_runtime.ttypes import SchedulerMode
 
 class SimpleSwitchAPI(runtime_CLI.RuntimeAPI):
     @staticmethod
@@ -20,13 +21,68 @@ class SimpleSwitchAPI(runtime_CLI.RuntimeAPI):
     def do_set_queue_depth(self, line):
         "Set depth of egress queue: set_queue_depth <nb_pkts>"
         depth = int(line)
-        self.sswitch_client.set_egress_queue_depth(depth)
+        if self.sswitch_client.set_egress_queue_depth(depth):
+            print "Invalid depth, the maximum is 1024"
 
     def do_set_queue_rate(self, line):
         "Set rate of egress queue: set_queue_rate <rate_pps>"
         rate = int(line)
         self.sswitch_client.set_egress_queue_rate(rate)
 
+    def do_set_priority_queue_depth(self, line):
+        "Set depth of one egress priority queue: set_priority_queue_depth <port> <priority> <nb_pkts>"
+        args = line.split()
+        port, priority, depth = int(args[0]), int(args[1]), int(args[2])
+        if self.sswitch_client.set_egress_priority_queue_depth(port, priority, depth):
+            print "Invalid port, priority or depth (the maximum is 1024)"
+
+    def do_set_priority_queue_rate(self, line):
+        "Set rate of one egress priority queue: set_priority_queue_rate <port> <priority> <rate_pps>"
+        args = line.split()
+        port, priority, rate = int(args[0]), int(args[1]), int(args[2])
+        if self.sswitch_client.set_egress_priority_queue_rate(port, priority, rate):
+            print "Invalid port or priority"
+
+    def do_set_priority_queue_byte_rate(self, line):
+        "Set byte rate of one egress priority queue: set_priority_queue_byte_rate <port> <priority> <bytes_per_sec> <burst_bytes>"
+        args = line.split()
+        port, priority = int(args[0]), int(args[1])
+        rate, burst = int(args[2]), int(args[3])
+        if self.sswitch_client.set_egress_priority_queue_byte_rate(port, priority, rate, burst):
+            print "Invalid port or priority"
+
+    def do_set_port_rate(self, line):
+        "Set rate of an egress port, for all its queues: set_port_rate <port> <rate_pps>"
+        args = line.split()
+        port, rate = int(args[0]), int(args[1])
+        if self.sswitch_client.set_egress_port_rate(port, rate):
+            print "Invalid port"
+
+    def do_set_port_byte_rate(self, line):
+        "Set byte rate of an egress port, for all its queues: set_port_byte_rate <port> <bytes_per_sec> <burst_bytes>"
+        args = line.split()
+        port, rate, burst = int(args[0]), int(args[1]), int(args[2])
+        if self.sswitch_client.set_egress_port_byte_rate(port, rate, burst):
+            print "Invalid port"
+
+    def do_set_scheduler(self, line):
+        "Set egress scheduler of a port: set_scheduler <port> <STRICT_PRIORITY|WRR|DWRR>"
+        args = line.split()
+        port = int(args[0])
+        if args[1] not in SchedulerMode._NAMES_TO_VALUES:
+            print "Invalid scheduler mode"
+            return
+        mode = SchedulerMode._NAMES_TO_VALUES[args[1]]
+        if self.sswitch_client.set_egress_scheduler(port, mode):
+            print "Invalid port"
+
+    def do_set_queue_weight(self, line):
+        "Set WRR / DWRR weight of an egress priority queue: set_queue_weight <port> <priority> <weight>"
+        args = line.split()
+        port, priority, weight = int(args[0]), int(args[1]), int(args[2])
+        if self.sswitch_client.set_egress_queue_weight(port, priority, weight):
+            print "Invalid port, priority or weight"
+
     def do_mirroring_add(self, line):
         "Add mirroring mapping: mirroring_add <mirror_id> <egress_port>"
         args = line.split()
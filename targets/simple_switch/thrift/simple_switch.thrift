@@ -21,13 +21,38 @@
 namespace cpp sswitch_runtime
 namespace py sswitch_runtime
 
+enum SchedulerMode {
+  STRICT_PRIORITY = 0,
+  WRR = 1,
+  DWRR = 2
+}
+
 service SimpleSwitch {
 
   i32 mirroring_mapping_add(1:i32 mirror_id, 2:i32 egress_port);
   i32 mirroring_mapping_delete(1:i32 mirror_id);
   i32 mirroring_mapping_get_egress_port(1:i32 mirror_id);
 
+  // depths above 1024 packets are rejected and return 1
   i32 set_egress_queue_depth(1:i32 depth_pkts);
   i32 set_egress_queue_rate(1:i64 rate_pps);
 
+  // queues of a given port and priority, higher priorities are served first
+  // with STRICT_PRIORITY; all return 1 if the port or priority is invalid, or
+  // if the depth is above 1024 packets
+  i32 set_egress_priority_queue_depth(1:i32 port, 2:i32 priority,
+                                      3:i32 depth_pkts);
+  i32 set_egress_priority_queue_rate(1:i32 port, 2:i32 priority,
+                                     3:i64 rate_pps);
+  i32 set_egress_priority_queue_byte_rate(1:i32 port, 2:i32 priority,
+                                          3:i64 bytes_per_sec,
+                                          4:i32 burst_bytes);
+  i32 set_egress_scheduler(1:i32 port, 2:SchedulerMode mode);
+  i32 set_egress_queue_weight(1:i32 port, 2:i32 priority, 3:i32 weight);
+
+  // shared by all the queues of the port
+  i32 set_egress_port_rate(1:i32 port, 2:i64 rate_pps);
+  i32 set_egress_port_byte_rate(1:i32 port, 2:i64 bytes_per_sec,
+                                3:i32 burst_bytes);
+
 }
@@ -46,6 +46,67 @@ class SimpleSwitchHandler : virtual public SimpleSwitchIf {
     return switch_->set_egress_queue_rate(static_cast<uint64_t>(rate_pps));
   }
 
+  int32_t set_egress_priority_queue_depth(const int32_t port,
+					  const int32_t priority,
+					  const int32_t depth_pkts) {
+    printf("set_egress_priority_queue_depth\n");
+    if(priority < 0) return 1;
+    return switch_->set_egress_priority_queue_depth(
+      port, static_cast<size_t>(priority), static_cast<size_t>(depth_pkts));
+  }
+
+  int32_t set_egress_priority_queue_rate(const int32_t port,
+					 const int32_t priority,
+					 const int64_t rate_pps) {
+    printf("set_egress_priority_queue_rate\n");
+    if(priority < 0) return 1;
+    return switch_->set_egress_priority_queue_rate(
+      port, static_cast<size_t>(priority), static_cast<uint64_t>(rate_pps));
+  }
+
+  int32_t set_egress_priority_queue_byte_rate(const int32_t port,
+					      const int32_t priority,
+					      const int64_t bytes_per_sec,
+					      const int32_t burst_bytes) {
+    printf("set_egress_priority_queue_byte_rate\n");
+    if(priority < 0 || burst_bytes < 0) return 1;
+    return switch_->set_egress_priority_queue_byte_rate(
+      port, static_cast<size_t>(priority),
+      static_cast<uint64_t>(bytes_per_sec), static_cast<uint64_t>(burst_bytes)
+    );
+  }
+
+  int32_t set_egress_scheduler(const int32_t port,
+			       const SchedulerMode::type mode) {
+    printf("set_egress_scheduler\n");
+    return switch_->set_egress_scheduler(
+      port, static_cast<EgressPort::SchedulerMode>(mode));
+  }
+
+  int32_t set_egress_queue_weight(const int32_t port, const int32_t priority,
+				  const int32_t weight) {
+    printf("set_egress_queue_weight\n");
+    if(priority < 0 || weight < 0) return 1;
+    return switch_->set_egress_queue_weight(
+      port, static_cast<size_t>(priority), static_cast<uint32_t>(weight));
+  }
+
+  int32_t set_egress_port_rate(const int32_t port, const int64_t rate_pps) {
+    printf("set_egress_port_rate\n");
+    return switch_->set_egress_port_rate(port, static_cast<uint64_t>(rate_pps));
+  }
+
+  int32_t set_egress_port_byte_rate(const int32_t port,
+				    const int64_t bytes_per_sec,
+				    const int32_t burst_bytes) {
+    printf("set_egress_port_byte_rate\n");
+    if(burst_bytes < 0) return 1;
+    return switch_->set_egress_port_byte_rate(
+      port, static_cast<uint64_t>(bytes_per_sec),
+      static_cast<uint64_t>(burst_bytes)
+    );
+  }
+
 private:
   SimpleSwitch *switch_;
 };
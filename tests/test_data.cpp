@@ -23,6 +23,7 @@
 #include <string>
 
 #include "bm_sim/data.h"
+#include "bm_sim/fields.h"
 
 TEST(Data, ConstructorFromUInt) {
   const Data d(0xaba);
@@ -109,3 +110,85 @@ TEST(Data, ShiftRight) {
   d3.shift_right(d1, d2);
   EXPECT_EQ((0xabababa) >> 3, d3.get_int());
 }
+
+TEST(Data, AddOverflow) {
+  // 2^126 + 2^126 does not fit in a native integer
+  Data d1("0x40000000000000000000000000000000");
+  Data d2;
+  d2.add(d1, d1);
+  EXPECT_EQ(Data("0x80000000000000000000000000000000"), d2);
+  Data d3;
+  d3.sub(d2, d1);
+  EXPECT_EQ(d1, d3);
+  EXPECT_GT(d2, d1);
+  EXPECT_LT(d1, d2);
+}
+
+TEST(Data, ShiftLeftOverflow) {
+  Data d1(0xab);
+  Data d2;
+  d2.shift_left(d1, 128);
+  EXPECT_EQ(Data("0xab00000000000000000000000000000000"), d2);
+  Data d3;
+  d3.shift_right(d2, 128);
+  EXPECT_EQ(d1, d3);
+}
+
+TEST(Data, WideCompare) {
+  const Data big("0xffffffffffffffffffffffffffffffffff");
+  const Data neg("-0xffffffffffffffffffffffffffffffffff");
+  const Data small(1);
+  EXPECT_GT(big, small);
+  EXPECT_LT(neg, small);
+  EXPECT_NE(big, small);
+  EXPECT_LT(neg, big);
+}
+
+TEST(Field, ExportBytesMasked) {
+  Field f8(8);
+  f8.set(-1);
+  EXPECT_EQ((unsigned) 0xff, f8.get_uint());
+  EXPECT_EQ(ByteContainer("0xff"), f8.get_bytes());
+  f8.add(f8, Data(2));
+  EXPECT_EQ((unsigned) 0x01, f8.get_uint());
+  EXPECT_EQ(ByteContainer("0x01"), f8.get_bytes());
+}
+
+TEST(Field, ExportBytes128) {
+  Field f128(128);
+  f128.set(-1);
+  EXPECT_EQ(Data("0xffffffffffffffffffffffffffffffff"), f128);
+  EXPECT_EQ(ByteContainer("0xffffffffffffffffffffffffffffffff"),
+	    f128.get_bytes());
+  f128.set("0xfe800000000000000000000000000001");
+  f128.add(f128, Data(1));
+  EXPECT_EQ(ByteContainer("0xfe800000000000000000000000000002"),
+	    f128.get_bytes());
+  f128.set(0xab);
+  EXPECT_EQ(ByteContainer("0x000000000000000000000000000000ab"),
+	    f128.get_bytes());
+}
+
+TEST(Field, LazySync) {
+  Field f16(16);
+  const char data[2] = {'\x0a', '\xba'};
+  f16.extract(data, 0);
+  // value is imported from the bytes the first time it is needed
+  EXPECT_EQ((unsigned) 0xaba, f16.get_uint());
+  Data d;
+  d.add(f16, Data(1));
+  EXPECT_EQ((unsigned) 0xabb, d.get_uint());
+
+  // bytes are exported from the value the first time they are needed
+  f16.set(0xabb);
+  char out[2] = {0, 0};
+  f16.deparse(out, 0);
+  EXPECT_EQ('\x0a', out[0]);
+  EXPECT_EQ('\xbb', out[1]);
+  f16.set(0xabc);
+  EXPECT_EQ(ByteContainer("0x0abc"), f16.get_bytes());
+
+  const Field f16_copy(f16);
+  EXPECT_EQ(f16, f16_copy);
+  EXPECT_EQ(ByteContainer("0x0abc"), f16_copy.get_bytes());
+}
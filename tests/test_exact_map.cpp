@@ -0,0 +1,140 @@
+/* Copyright 2013-present Barefoot Networks, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Antonin Bas (antonin@barefootnetworks.com)
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <unordered_map>
+#include <random>
+
+#include "bm_sim/exact_map.h"
+
+static ByteContainer make_key(uint64_t v, size_t width) {
+  ByteContainer key;
+  for(size_t i = 0; i < width; i++) {
+    key.push_back(static_cast<char>(v & 0xff));
+    v >>= 8;
+  }
+  return key;
+}
+
+TEST(ExactMap, InsertLookupRemove) {
+  ExactMap map(6, 16);
+  ExactMap::value_t value;
+  const ByteContainer key("0x0a0b0c0d0e0f");
+  ASSERT_FALSE(map.lookup(key, &value));
+  ASSERT_TRUE(map.insert(key, 33));
+  ASSERT_FALSE(map.insert(key, 34));
+  ASSERT_TRUE(map.has_key(key));
+  ASSERT_TRUE(map.lookup(key, &value));
+  ASSERT_EQ(33u, value);
+  ASSERT_EQ(1u, map.size());
+  ASSERT_FALSE(map.lookup(ByteContainer("0x0a0b0c0d0e00"), &value));
+  ASSERT_TRUE(map.remove(key));
+  ASSERT_FALSE(map.remove(key));
+  ASSERT_FALSE(map.lookup(key, &value));
+  ASSERT_EQ(0u, map.size());
+}
+
+TEST(ExactMap, EmptyKey) {
+  ExactMap map(0, 1);
+  ExactMap::value_t value;
+  ASSERT_TRUE(map.insert(ByteContainer(), 7));
+  ASSERT_FALSE(map.insert(ByteContainer(), 8));
+  ASSERT_TRUE(map.lookup(ByteContainer(), &value));
+  ASSERT_EQ(7u, value);
+}
+
+TEST(ExactMap, Full) {
+  const size_t nb_entries = 1000;
+  for(size_t width : {1, 4, 8, 13}) {
+    ExactMap map(width, nb_entries);
+    const size_t n = (width == 1) ? 256 : nb_entries;
+    for(size_t i = 0; i < n; i++)
+      ASSERT_TRUE(map.insert(make_key(i, width), i));
+    ExactMap::value_t value;
+    for(size_t i = 0; i < n; i++) {
+      ASSERT_TRUE(map.lookup(make_key(i, width), &value));
+      ASSERT_EQ(i, value);
+    }
+    if(width > 1) {
+      ASSERT_FALSE(map.lookup(make_key(n, width), &value));
+    }
+  }
+}
+
+// deleting and inserting many times leaves deleted slots behind, which have to
+// be reclaimed
+TEST(ExactMap, Churn) {
+  const size_t nb_entries = 512;
+  const size_t width = 6;
+  ExactMap map(width, nb_entries);
+  std::unordered_map<uint64_t, ExactMap::value_t> ref;
+  std::mt19937_64 gen(1);
+  std::uniform_int_distribution<uint64_t> dis(0, 4 * nb_entries);
+  ExactMap::value_t value;
+  for(size_t i = 0; i < 100000; i++) {
+    uint64_t k = dis(gen);
+    ByteContainer key = make_key(k, width);
+    if(ref.count(k)) {
+      ASSERT_TRUE(map.remove(key));
+      ref.erase(k);
+    }
+    else if(ref.size() < nb_entries) {
+      ASSERT_TRUE(map.insert(key, i));
+      ref[k] = i;
+    }
+    ASSERT_EQ(ref.size(), map.size());
+  }
+  for(uint64_t k = 0; k <= 4 * nb_entries; k++) {
+    auto it = ref.find(k);
+    if(it == ref.end()) {
+      ASSERT_FALSE(map.lookup(make_key(k, width), &value));
+    }
+    else {
+      ASSERT_TRUE(map.lookup(make_key(k, width), &value));
+      ASSERT_EQ(it->second, value);
+    }
+  }
+}
+
+TEST(ExactMap, Clear) {
+  ExactMap map(4, 64);
+  for(size_t i = 0; i < 64; i++) ASSERT_TRUE(map.insert(make_key(i, 4), i));
+  map.clear();
+  ASSERT_EQ(0u, map.size());
+  ExactMap::value_t value;
+  for(size_t i = 0; i < 64; i++)
+    ASSERT_FALSE(map.lookup(make_key(i, 4), &value));
+  ASSERT_TRUE(map.insert(make_key(3, 4), 3));
+}
+
+TEST(ExactMap, Grow) {
+  ExactMap map(5);
+  ExactMap::value_t value;
+  for(size_t i = 0; i < 10000; i++)
+    ASSERT_TRUE(map.insert(make_key(i, 5), i));
+  ASSERT_EQ(10000u, map.size());
+  for(size_t i = 0; i < 10000; i++) {
+    ASSERT_TRUE(map.lookup(make_key(i, 5), &value));
+    ASSERT_EQ(i, value);
+  }
+  ASSERT_FALSE(map.lookup(make_key(10000, 5), &value));
+}
@@ -0,0 +1,203 @@
+/* Copyright 2013-present Barefoot Networks, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Antonin Bas (antonin@barefootnetworks.com)
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <map>
+#include <algorithm>
+#include <utility>
+#include <random>
+
+#include "bm_sim/lpm_poptrie.h"
+
+namespace {
+
+ByteContainer mask_prefix(ByteContainer prefix, int prefix_length) {
+  for(size_t i = 0; i < prefix.size(); i++) {
+    int bits = std::min(std::max(prefix_length - static_cast<int>(i * 8), 0), 8);
+    prefix[i] &= static_cast<char>(0xff00 >> bits);
+  }
+  return prefix;
+}
+
+}  // namespace
+
+// compares the Poptrie with a scan of all the prefixes
+class LPMPoptrieTest : public ::testing::TestWithParam<size_t> {
+protected:
+  const size_t key_width;
+
+  LPMPoptrie lpm;
+  std::map<std::pair<int, std::string>, uintptr_t> prefixes{};
+  std::mt19937 gen{0};
+
+  LPMPoptrieTest()
+    : key_width(GetParam()), lpm(key_width) { }
+
+  // keys close to 2001::, with few values per byte so that prefixes overlap
+  ByteContainer random_key() {
+    std::uniform_int_distribution<int> byte_dis(0, 255);
+    std::uniform_int_distribution<int> low_dis(0, 3);
+    ByteContainer key;
+    key.push_back(0x20);
+    key.push_back(0x01);
+    for(size_t i = 2; i < key_width - 1; i++) key.push_back(low_dis(gen) << 6);
+    key.push_back(byte_dis(gen));
+    return key;
+  }
+
+  // short prefixes cover a lot of entries, so they are rare, like in a FIB
+  int random_length() {
+    std::uniform_int_distribution<int> short_dis(0, 49);
+    int min_length = (short_dis(gen) == 0) ? 0 : LPMPoptrie::top_bits;
+    std::uniform_int_distribution<int> dis(min_length, key_width * 8);
+    return dis(gen);
+  }
+
+  void insert(const ByteContainer &prefix, int prefix_length,
+	      uintptr_t value) {
+    lpm.insert_prefix(prefix, prefix_length, value);
+    ByteContainer masked = mask_prefix(prefix, prefix_length);
+    prefixes[std::make_pair(prefix_length,
+			    std::string(masked.data(), key_width))] = value;
+  }
+
+  void remove(const ByteContainer &prefix, int prefix_length) {
+    ByteContainer masked = mask_prefix(prefix, prefix_length);
+    auto it = prefixes.find(
+      std::make_pair(prefix_length, std::string(masked.data(), key_width))
+    );
+    ASSERT_EQ(it != prefixes.end(), lpm.delete_prefix(prefix, prefix_length));
+    if(it != prefixes.end()) prefixes.erase(it);
+  }
+
+  void check_lookup(const ByteContainer &key) {
+    bool hit = false;
+    uintptr_t expected = 0, actual = 0;
+    // the map is sorted by prefix length, so the last match is the longest
+    for(const auto &p : prefixes) {
+      ByteContainer masked = mask_prefix(key, p.first.first);
+      if(std::string(masked.data(), key_width) == p.first.second) {
+	hit = true;
+	expected = p.second;
+      }
+    }
+    ASSERT_EQ(hit, lpm.lookup(key, &actual));
+    if(hit) {
+      ASSERT_EQ(expected, actual);
+    }
+  }
+};
+
+TEST_P(LPMPoptrieTest, Basic) {
+  ByteContainer key = random_key();
+  uintptr_t value;
+  ASSERT_FALSE(lpm.lookup(key, &value));
+
+  const int key_length = key_width * 8;
+  insert(key, 16, 1);
+  insert(key, key_length - 4, 2);
+  insert(key, key_length, 3);
+  ASSERT_TRUE(lpm.has_prefix(key, key_length - 4));
+  ASSERT_FALSE(lpm.has_prefix(key, 20));
+  ASSERT_TRUE(lpm.lookup(key, &value));
+  ASSERT_EQ(3u, value);
+
+  remove(key, key_length);
+  ASSERT_TRUE(lpm.lookup(key, &value));
+  ASSERT_EQ(2u, value);
+  remove(key, key_length - 4);
+  ASSERT_TRUE(lpm.lookup(key, &value));
+  ASSERT_EQ(1u, value);
+  ASSERT_EQ(0u, lpm.get_num_nodes());
+
+  // replacing the value of a prefix
+  insert(key, 16, 4);
+  ASSERT_TRUE(lpm.lookup(key, &value));
+  ASSERT_EQ(4u, value);
+
+  remove(key, 16);
+  ASSERT_FALSE(lpm.lookup(key, &value));
+  ASSERT_FALSE(lpm.delete_prefix(key, 16));
+}
+
+TEST_P(LPMPoptrieTest, DefaultRoute) {
+  insert(random_key(), 0, 7);
+  for(int i = 0; i < 100; i++) check_lookup(random_key());
+  insert(random_key(), 48, 8);
+  for(int i = 0; i < 100; i++) check_lookup(random_key());
+  remove(random_key(), 0);
+  for(int i = 0; i < 100; i++) check_lookup(random_key());
+}
+
+TEST_P(LPMPoptrieTest, Random) {
+  std::uniform_int_distribution<int> op_dis(0, 2);
+  uintptr_t next_value = 0;
+  for(int i = 0; i < 2000; i++) {
+    if(op_dis(gen) == 0 && !prefixes.empty()) {
+      std::uniform_int_distribution<size_t> dis(0, prefixes.size() - 1);
+      auto it = prefixes.begin();
+      std::advance(it, dis(gen));
+      ByteContainer prefix(it->first.second.data(), key_width);
+      remove(prefix, it->first.first);
+    }
+    else {
+      insert(random_key(), random_length(), next_value++);
+    }
+    check_lookup(random_key());
+  }
+  for(int i = 0; i < 2000; i++) check_lookup(random_key());
+
+  while(!prefixes.empty()) {
+    ByteContainer prefix(prefixes.begin()->first.second.data(), key_width);
+    remove(prefix, prefixes.begin()->first.first);
+    check_lookup(random_key());
+  }
+
+  insert(random_key(), random_length(), next_value++);
+  lpm.clear();
+  prefixes.clear();
+  check_lookup(random_key());
+}
+
+// the prefixes inserted in a batch can only be looked up once it is over
+TEST_P(LPMPoptrieTest, Batch) {
+  uintptr_t next_value = 0;
+  for(int batch = 0; batch < 3; batch++) {
+    lpm.begin_batch();
+    for(int i = 0; i < 500; i++)
+      insert(random_key(), random_length(), next_value++);
+    for(int i = 0; i < 50; i++) {
+      ByteContainer prefix(prefixes.begin()->first.second.data(), key_width);
+      remove(prefix, prefixes.begin()->first.first);
+    }
+    lpm.end_batch();
+    for(int i = 0; i < 500; i++) check_lookup(random_key());
+  }
+  while(prefixes.size() > 100) {
+    ByteContainer prefix(prefixes.begin()->first.second.data(), key_width);
+    remove(prefix, prefixes.begin()->first.first);
+  }
+  for(int i = 0; i < 500; i++) check_lookup(random_key());
+}
+
+INSTANTIATE_TEST_CASE_P(LPMPoptrieKeyWidths, LPMPoptrieTest,
+			::testing::Values(5, 16, 17));
@@ -24,6 +24,7 @@
 #include <string>
 
 #include <cassert>
+#include <cstring>
 
 #include "bm_sim/phv.h"
 
@@ -35,7 +36,7 @@ protected:
   std::unique_ptr<PHV> phv;
 
   HeaderType testHeaderType;
-  header_id_t testHeader1{0}, testHeader2{1};
+  header_id_t testHeader1{0}, testHeader2{1}, testMeta{2};
 
   PHVTest()
     : testHeaderType("test_t", 0) {
@@ -43,6 +44,7 @@ protected:
     testHeaderType.push_back_field("f48", 48);
     phv_factory.push_back_header("test1", testHeader1, testHeaderType);
     phv_factory.push_back_header("test2", testHeader2, testHeaderType);
+    phv_factory.push_back_header("meta", testMeta, testHeaderType, true);
   }
 
   virtual void SetUp() {
@@ -84,3 +86,131 @@ TEST_F(PHVTest, CopyHeaders) {
   ASSERT_EQ(f48, f48_2);
 }
 
+
+TEST_F(PHVTest, Reset) {
+  Header &hdr = phv->get_header(testHeader1);
+  Header &meta = phv->get_header(testMeta);
+  hdr.mark_valid();
+  hdr.get_field(0).set(0xaba);
+  meta.get_field(0).set(0xaba);
+  Field &f48 = phv->get_field("meta.f48");
+  f48.set("0xaabbccddeeff");
+
+  phv->reset();
+  ASSERT_FALSE(hdr.is_valid());
+  ASSERT_TRUE(meta.is_valid());
+  // invalidating does not touch the values
+  ASSERT_EQ(0xaba, hdr.get_field(0).get_int());
+  ASSERT_EQ(0xaba, meta.get_field(0).get_int());
+
+  hdr.mark_valid();
+  ASSERT_TRUE(hdr.is_valid());
+
+  phv->reset_metadata();
+  ASSERT_EQ(0xaba, hdr.get_field(0).get_int());
+  ASSERT_EQ(0, meta.get_field(0).get_int());
+  ASSERT_EQ(0, phv->get_field("meta.f48").get_int());
+  ASSERT_EQ(0, f48.get_int());
+
+  meta[1].set(1);
+  ASSERT_EQ(1, phv->get_field("meta.f48").get_int());
+
+  // the zeroed metadata is copied
+  std::unique_ptr<PHV> phv_2 = phv_factory.create();
+  phv_2->get_field("meta.f16").set(7);
+  phv->reset_metadata();
+  phv_2->copy_headers(*phv);
+  ASSERT_EQ(0, phv_2->get_field("meta.f16").get_int());
+  ASSERT_EQ(0, phv_2->get_field("meta.f48").get_int());
+}
+
+TEST_F(PHVTest, ShareHeaders) {
+  phv->get_header(testHeader1).mark_valid();
+  phv->get_field(testHeader1, 0).set(0xaba);
+  phv->get_field(testHeader1, 1).set("0xaabbccddeeff");
+  phv->get_field(testHeader2, 0).set(0xcd);
+  phv->get_field(testMeta, 0).set(1);
+  phv->sync();
+
+  std::shared_ptr<const PHV> src(std::move(phv));
+  std::unique_ptr<PHV> phv_1 = phv_factory.create();
+  std::unique_ptr<PHV> phv_2 = phv_factory.create();
+  phv_1->share_headers(src);
+  phv_2->share_headers(src);
+  ASSERT_TRUE(phv_1->shares_headers_with(*src));
+
+  const PHV &phv_1_c = *phv_1;
+  ASSERT_TRUE(phv_1_c.get_header(testHeader1).is_valid());
+  ASSERT_FALSE(phv_1_c.get_header(testHeader2).is_valid());
+  // const accesses read the shared fields
+  ASSERT_EQ(&src->get_field(testHeader1, 0), &phv_1_c.get_field(testHeader1, 0));
+  ASSERT_EQ(0xaba, phv_1_c.get_field(testHeader1, 0).get_int());
+
+  // a non-const access copies the header first
+  Field &f16 = phv_1->get_field(testHeader1, 0);
+  ASSERT_NE(&src->get_field(testHeader1, 0), &f16);
+  f16.set(0xcd);
+  ASSERT_FALSE(phv_1->shares_headers_with(*src));
+  ASSERT_EQ(0xcd, phv_1_c.get_field(testHeader1, 0).get_int());
+  ASSERT_EQ(0xaabbccddeeffull, phv_1_c.get_field(testHeader1, 1).get_uint64());
+  ASSERT_EQ(0xaba, src->get_field(testHeader1, 0).get_int());
+  ASSERT_EQ(0xaba, phv_2->get_field(testHeader1, 0).get_int());
+
+  // sharing from a PHV which is itself sharing
+  std::shared_ptr<const PHV> src_2(std::move(phv_2));
+  std::unique_ptr<PHV> phv_3 = phv_factory.create();
+  phv_3->share_headers(src_2);
+  ASSERT_EQ(&src->get_field(testMeta, 0),
+	    &static_cast<const PHV &>(*phv_3).get_field(testMeta, 0));
+  phv_3->reset_metadata();
+  ASSERT_EQ(0, phv_3->get_field(testMeta, 0).get_int());
+  ASSERT_EQ(1, src->get_field(testMeta, 0).get_int());
+
+  phv_3->reset();
+  ASSERT_FALSE(phv_3->shares_headers_with(*src_2));
+}
+
+TEST(HeaderType, ExtractionPlan) {
+  typedef HeaderType::PlanStep::Type StepType;
+  HeaderType header_type("test_t", 0);
+  header_type.push_back_field("f16", 16);
+  header_type.push_back_field("f48", 48);
+  header_type.push_back_field("f4_1", 4);
+  header_type.push_back_field("f4_2", 4);
+  header_type.push_back_field("f8", 8);
+
+  const auto &plan = header_type.get_plan();
+  ASSERT_EQ(4u, plan.size());
+  EXPECT_EQ(StepType::COPY, plan[0].type);
+  EXPECT_EQ(0, plan[0].byte_offset);
+  EXPECT_EQ(8, plan[0].nbytes);
+  EXPECT_EQ(0, plan[0].field_begin);
+  EXPECT_EQ(2, plan[0].field_end);
+  EXPECT_EQ(StepType::SHIFT, plan[1].type);
+  EXPECT_EQ(8, plan[1].byte_offset);
+  EXPECT_EQ(0, plan[1].bit_offset);
+  EXPECT_EQ(StepType::SHIFT, plan[2].type);
+  EXPECT_EQ(8, plan[2].byte_offset);
+  EXPECT_EQ(4, plan[2].bit_offset);
+  EXPECT_EQ(StepType::COPY, plan[3].type);
+  EXPECT_EQ(9, plan[3].byte_offset);
+  EXPECT_EQ(1, plan[3].nbytes);
+
+  PHVFactory phv_factory;
+  phv_factory.push_back_header("test", 0, header_type);
+  phv_factory.enable_all_field_arith(0);
+  std::unique_ptr<PHV> phv = phv_factory.create();
+  Header &header = phv->get_header(0);
+  const char data[10] = {'\x0a', '\xba', '\x01', '\x02', '\x03',
+			 '\x04', '\x05', '\x06', '\xcd', '\xef'};
+  header.extract(data);
+  EXPECT_EQ((unsigned) 0x0aba, header[0].get_uint());
+  EXPECT_EQ(0x010203040506ull, header[1].get_uint64());
+  EXPECT_EQ((unsigned) 0xc, header[2].get_uint());
+  EXPECT_EQ((unsigned) 0xd, header[3].get_uint());
+  EXPECT_EQ((unsigned) 0xef, header[4].get_uint());
+
+  char out[10] = {0};
+  header.deparse(out);
+  EXPECT_EQ(0, memcmp(data, out, sizeof(data)));
+}
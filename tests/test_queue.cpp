@@ -21,6 +21,8 @@
 #include <gtest/gtest.h>
 
 #include <thread>
+#include <vector>
+#include <atomic>
 
 #include "bm_sim/queue.h"
 
@@ -85,3 +87,189 @@ INSTANTIATE_TEST_CASE_P(TestParameters,
                         QueueTest,
                         Combine(Values(16, 1024, 20000),
 				Values(1000, 200000)));
+
+class RingQueueTest : public TestWithParam< std::tuple<size_t, int> > {
+protected:
+  int iterations;
+  size_t queue_size;
+  static const int nb_producers = 4;
+
+  unique_ptr<RingQueue<int, RingQueuePolicy::MPSC> > queue;
+
+  virtual void SetUp() {
+    queue_size = std::get<0>(GetParam());
+    iterations = std::get<1>(GetParam());
+
+    queue = unique_ptr<RingQueue<int, RingQueuePolicy::MPSC> >(
+      new RingQueue<int, RingQueuePolicy::MPSC>(queue_size)
+    );
+  }
+
+public:
+  void produce(int producer_id) {
+    for(int i = 0; i < iterations; i++) {
+      queue->push_front(producer_id * iterations + i);
+    }
+  }
+};
+
+TEST_P(RingQueueTest, ProducersConsumer) {
+  std::vector<thread> producer_threads;
+  for(int p = 0; p < nb_producers; p++)
+    producer_threads.push_back(thread(&RingQueueTest::produce, this, p));
+
+  // the values of each producer need to come out in order
+  std::vector<int> next(nb_producers, 0);
+  int value;
+  for(int i = 0; i < nb_producers * iterations; i++) {
+    queue->pop_back(&value);
+    int p = value / iterations;
+    ASSERT_EQ(next[p]++, value % iterations);
+  }
+  ASSERT_EQ(0u, queue->size());
+
+  for(auto &t : producer_threads) t.join();
+}
+
+INSTANTIATE_TEST_CASE_P(TestParameters,
+                        RingQueueTest,
+                        Combine(Values(16, 1024),
+				Values(1000, 200000)));
+
+// the queue is never more than half full, so a push must never fail, even when
+// the tail read by a producer is stale and the consumers have moved the head
+// past it
+TEST(RingQueue, NoSpuriousFull) {
+  typedef RingQueue<int, RingQueuePolicy::MPMC> QueueType;
+  const size_t capacity = 16;
+  const int nb_threads = 4;
+  const int iterations = 20000;
+  QueueType queue(capacity, QueueType::WriteReturn);
+  std::atomic<size_t> in_queue{0};
+  std::atomic<int> nb_failed{0};
+  std::atomic<int> nb_popped{0};
+
+  auto produce = [&]() {
+    std::vector<int> item;
+    for(int i = 0; i < iterations; i++) {
+      while(in_queue.fetch_add(1) >= capacity / 2) {
+	in_queue.fetch_sub(1);
+	std::this_thread::yield();
+      }
+      item.assign(1, i);
+      if(queue.push_front_batch(&item) != 1) {
+	in_queue.fetch_sub(1);
+	nb_failed++;
+      }
+    }
+  };
+  auto consume = [&]() {
+    std::vector<int> values;
+    while(nb_popped.load() + nb_failed.load() < nb_threads * iterations) {
+      values.clear();
+      size_t n = queue.try_pop_back_batch(&values, 4);
+      if(n == 0) {
+	std::this_thread::yield();
+	continue;
+      }
+      in_queue.fetch_sub(n);
+      nb_popped += n;
+    }
+  };
+  std::vector<thread> threads;
+  for(int i = 0; i < nb_threads; i++) {
+    threads.push_back(thread(produce));
+    threads.push_back(thread(consume));
+  }
+  for(auto &t : threads) t.join();
+  ASSERT_EQ(0, nb_failed.load());
+  ASSERT_EQ(nb_threads * iterations, nb_popped.load());
+}
+
+TEST(RingQueue, Capacity) {
+  typedef RingQueue<int, RingQueuePolicy::SPSC> QueueType;
+  QueueType queue(10, QueueType::WriteReturn);
+  ASSERT_EQ(10u, queue.get_capacity());
+  for(int i = 0; i < 20; i++) queue.push_front(i);
+  ASSERT_EQ(10u, queue.size());
+  queue.set_capacity(100);
+  // capped by the number of cells
+  ASSERT_EQ(16u, queue.get_capacity());
+  int value;
+  queue.pop_back(&value);
+  ASSERT_EQ(0, value);
+}
+
+template <typename QueueType>
+static void batch_producers_consumer(QueueType *queue, int iterations) {
+  const int nb_producers = 2;
+  auto produce = [queue, iterations](int producer_id) {
+    std::vector<int> batch;
+    for(int i = 0; i < iterations; i++) {
+      batch.push_back(producer_id * iterations + i);
+      if(batch.size() == 7 || i == iterations - 1) {
+	queue->push_front_batch(&batch);
+	ASSERT_TRUE(batch.empty());
+      }
+    }
+  };
+  std::vector<thread> producer_threads;
+  for(int p = 0; p < nb_producers; p++)
+    producer_threads.push_back(thread(produce, p));
+
+  std::vector<int> next(nb_producers, 0);
+  std::vector<int> values;
+  int popped = 0;
+  while(popped < nb_producers * iterations) {
+    values.clear();
+    size_t n = queue->pop_back_batch(&values, 32);
+    ASSERT_LE(1u, n);
+    ASSERT_GE(32u, n);
+    ASSERT_EQ(n, values.size());
+    for(int value : values) {
+      int p = value / iterations;
+      ASSERT_EQ(next[p]++, value % iterations);
+    }
+    popped += n;
+  }
+  ASSERT_EQ(0u, queue->size());
+
+  for(auto &t : producer_threads) t.join();
+}
+
+TEST(Queue, Batch) {
+  Queue<int> queue(64);
+  batch_producers_consumer(&queue, 100000);
+}
+
+TEST(RingQueue, Batch) {
+  RingQueue<int, RingQueuePolicy::MPSC> queue(64);
+  batch_producers_consumer(&queue, 100000);
+}
+
+TEST(RingQueue, BatchWriteReturn) {
+  typedef RingQueue<int, RingQueuePolicy::SPSC> QueueType;
+  QueueType queue(8, QueueType::WriteReturn);
+  std::vector<int> values = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9};
+  // the last 2 values are dropped
+  ASSERT_EQ(8u, queue.push_front_batch(&values));
+  ASSERT_EQ(8u, queue.size());
+  ASSERT_EQ(5u, queue.pop_back_batch(&values, 5));
+  ASSERT_EQ(3u, queue.pop_back_batch(&values, 5));
+  for(int i = 0; i < 8; i++) ASSERT_EQ(i, values[i]);
+}
+
+TEST(RingQueue, TryPopBatch) {
+  RingQueue<int, RingQueuePolicy::MPSC> queue(8);
+  std::vector<int> values;
+  ASSERT_TRUE(queue.empty());
+  ASSERT_EQ(0u, queue.try_pop_back_batch(&values, 4));
+  values = {0, 1, 2, 3, 4, 5};
+  queue.push_front_batch(&values);
+  ASSERT_FALSE(queue.empty());
+  ASSERT_EQ(4u, queue.try_pop_back_batch(&values, 4));
+  ASSERT_EQ(2u, queue.try_pop_back_batch(&values, 4));
+  ASSERT_TRUE(queue.empty());
+  ASSERT_EQ(0u, queue.try_pop_back_batch(&values, 4));
+  for(int i = 0; i < 6; i++) ASSERT_EQ(i, values[i]);
+}
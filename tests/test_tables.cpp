@@ -33,6 +33,16 @@ typedef MatchUnitExact<ActionEntry> MUExact;
 typedef MatchUnitLPM<ActionEntry> MULPM;
 typedef MatchUnitTernary<ActionEntry> MUTernary;
 
+// for the bulk insertion tests: appends an entry with a one-field match key,
+// the other arguments being the rest of the entry
+template <typename NewEntry, typename... Args>
+static void push_entry(std::vector<NewEntry> *entries, MatchKeyParam param,
+		       Args &&... args) {
+  std::vector<MatchKeyParam> match_key;
+  match_key.push_back(std::move(param));
+  entries->push_back({std::move(match_key), std::forward<Args>(args)...});
+}
+
 template <typename MUType>
 class TableSizeTwo : public ::testing::Test {
 protected:
@@ -453,7 +463,7 @@ protected:
     key_builder.push_back_field(testHeader1, 0, 16);
 
     // with counters, without ageing
-    table = MatchTableIndirect::create("exact", "test_table", 0,
+    table = MatchTableIndirect::create("exact", "", "test_table", 0,
 				       table_size, key_builder,
 				       true, false);
     table->set_next_node(0, nullptr);
@@ -542,6 +552,34 @@ TEST_F(TableIndirect, AddEntry) {
   ASSERT_EQ(MatchErrorCode::TABLE_FULL, rc);
 }
 
+TEST_F(TableIndirect, AddEntries) {
+  mbr_hdl_t mbr;
+  ASSERT_EQ(MatchErrorCode::SUCCESS, add_member(666u, &mbr));
+
+  std::vector<MatchTableIndirect::NewEntry> entries;
+  const MatchKeyParam::Type exact = MatchKeyParam::Type::EXACT;
+  push_entry(&entries, MatchKeyParam(exact, "\x0a\xba"), mbr, -1);
+  push_entry(&entries, MatchKeyParam(exact, "\x0a\xbb"), 999u, -1);
+  push_entry(&entries, MatchKeyParam(exact, "\x0a\xba"), mbr, -1);
+  push_entry(&entries, MatchKeyParam(exact, "\x0a\xbc"), mbr, -1);
+
+  std::vector<MatchErrorCode> rcs;
+  std::vector<entry_handle_t> handles;
+  table->add_entries(entries, &rcs, &handles);
+  ASSERT_EQ(4u, rcs.size());
+  ASSERT_EQ(MatchErrorCode::SUCCESS, rcs[0]);
+  ASSERT_EQ(MatchErrorCode::INVALID_MBR_HANDLE, rcs[1]);
+  ASSERT_EQ(MatchErrorCode::DUPLICATE_ENTRY, rcs[2]);
+  ASSERT_EQ(MatchErrorCode::SUCCESS, rcs[3]);
+  ASSERT_EQ(2u, table->get_num_entries());
+
+  // the member is only used by the entries which were added
+  ASSERT_EQ(MatchErrorCode::SUCCESS, table->delete_entry(handles[0]));
+  ASSERT_EQ(MatchErrorCode::MBR_STILL_USED, table->delete_member(mbr));
+  ASSERT_EQ(MatchErrorCode::SUCCESS, table->delete_entry(handles[3]));
+  ASSERT_EQ(MatchErrorCode::SUCCESS, table->delete_member(mbr));
+}
+
 TEST_F(TableIndirect, DeleteMember) {
   std::string key("\x0a\xba");
   MatchErrorCode rc;
@@ -739,7 +777,7 @@ protected:
     key_builder.push_back_field(testHeader1, 0, 16);
 
     // with counters, without ageing
-    table = MatchTableIndirectWS::create("exact", "test_table", 0,
+    table = MatchTableIndirectWS::create("exact", "", "test_table", 0,
 					 table_size, key_builder,
 					 true, false);
     table->set_next_node(0, nullptr);
@@ -897,6 +935,37 @@ TEST_F(TableIndirectWS, EntryWS) {
   ASSERT_EQ(MatchErrorCode::SUCCESS, rc);
 }
 
+TEST_F(TableIndirectWS, AddEntriesWS) {
+  grp_hdl_t grp, grp_empty;
+  mbr_hdl_t mbr;
+  ASSERT_EQ(MatchErrorCode::SUCCESS, table->create_group(&grp));
+  ASSERT_EQ(MatchErrorCode::SUCCESS, table->create_group(&grp_empty));
+  ASSERT_EQ(MatchErrorCode::SUCCESS, add_member(666u, &mbr));
+  ASSERT_EQ(MatchErrorCode::SUCCESS, table->add_member_to_group(mbr, grp));
+
+  std::vector<MatchTableIndirectWS::NewEntryWS> entries;
+  const MatchKeyParam::Type exact = MatchKeyParam::Type::EXACT;
+  push_entry(&entries, MatchKeyParam(exact, "\x0a\xba"), grp, -1);
+  push_entry(&entries, MatchKeyParam(exact, "\x0a\xbb"), 999u, -1);
+  push_entry(&entries, MatchKeyParam(exact, "\x0a\xbc"), grp_empty, -1);
+  push_entry(&entries, MatchKeyParam(exact, "\x0a\xbd"), grp, -1);
+
+  std::vector<MatchErrorCode> rcs;
+  std::vector<entry_handle_t> handles;
+  table->add_entries_ws(entries, &rcs, &handles);
+  ASSERT_EQ(4u, rcs.size());
+  ASSERT_EQ(MatchErrorCode::SUCCESS, rcs[0]);
+  ASSERT_EQ(MatchErrorCode::INVALID_GRP_HANDLE, rcs[1]);
+  ASSERT_EQ(MatchErrorCode::EMPTY_GRP, rcs[2]);
+  ASSERT_EQ(MatchErrorCode::SUCCESS, rcs[3]);
+  ASSERT_EQ(2u, table->get_num_entries());
+
+  ASSERT_EQ(MatchErrorCode::SUCCESS, table->delete_entry(handles[0]));
+  ASSERT_EQ(MatchErrorCode::GRP_STILL_USED, table->delete_group(grp));
+  ASSERT_EQ(MatchErrorCode::SUCCESS, table->delete_entry(handles[3]));
+  ASSERT_EQ(MatchErrorCode::SUCCESS, table->delete_group(grp));
+}
+
 TEST_F(TableIndirectWS, LookupEntryWS) {
   MatchErrorCode rc;
   grp_hdl_t grp;
@@ -971,3 +1040,200 @@ TEST_F(TableIndirectWS, LookupEntryWS) {
   rc = table->delete_member(mbr_2);
   ASSERT_EQ(MatchErrorCode::SUCCESS, rc);
 }
+
+TEST(MatchKeyBuilder, Layout) {
+  PHVFactory phv_factory;
+  HeaderType testHeaderType("test_t", 0);
+  testHeaderType.push_back_field("f16", 16);
+  testHeaderType.push_back_field("f48", 48);
+  const header_id_t testHeader1 = 0, testHeader2 = 1;
+  phv_factory.push_back_header("test1", testHeader1, testHeaderType);
+  phv_factory.push_back_header("test2", testHeader2, testHeaderType);
+
+  // valid bytes always come first, whatever the order they are pushed in
+  MatchKeyBuilder key_builder;
+  key_builder.push_back_field(testHeader1, 1, 48);
+  key_builder.push_back_valid_header(testHeader2);
+  key_builder.push_back_field(testHeader2, 0, 16);
+  ASSERT_EQ(9u, key_builder.get_nbytes_key());
+
+  std::unique_ptr<PHV> phv = phv_factory.create();
+  phv->get_header(testHeader1).mark_valid();
+  phv->get_field(testHeader1, 1).set("0x0a0b0c0d0e0f");
+  phv->get_field(testHeader2, 0).set("0xabcd");
+
+  // the key is resized and overwritten, and the fields of the invalid header
+  // are zeroed
+  ByteContainer key("0xffffffffffffffffffffffff");
+  key_builder(*phv, key);
+  ASSERT_EQ(ByteContainer("0x000a0b0c0d0e0f0000"), key);
+
+  phv->get_header(testHeader2).mark_valid();
+  key_builder(*phv, key);
+  ASSERT_EQ(ByteContainer("0x010a0b0c0d0e0fabcd"), key);
+
+  char buffer[16];
+  std::fill(buffer, buffer + sizeof(buffer), '\xff');
+  key_builder(*phv, buffer);
+  ASSERT_EQ(ByteContainer("0x010a0b0c0d0e0fabcd"), ByteContainer(buffer, 9));
+  ASSERT_EQ('\xff', buffer[9]);
+}
+
+TEST(TableBulkAdd, Ternary) {
+  PHVFactory phv_factory;
+  HeaderType testHeaderType("test_t", 0);
+  testHeaderType.push_back_field("f16", 16);
+  const header_id_t testHeader1 = 0;
+  phv_factory.push_back_header("test1", testHeader1, testHeaderType);
+  Packet::set_phv_factory(phv_factory);
+
+  MatchKeyBuilder key_builder;
+  key_builder.push_back_field(testHeader1, 0, 16);
+  ActionFn action_fn("actionA", 0);
+
+  for(const char *algo : {"linear", "tuple_space", "packed_scan"}) {
+    std::unique_ptr<MatchTable> table = MatchTable::create(
+      "ternary", algo, "test_table", 0, 16, key_builder, false, false
+    );
+    table->set_next_node(0, nullptr);
+
+    std::vector<MatchTable::NewEntry> entries;
+    const MatchKeyParam::Type ternary = MatchKeyParam::Type::TERNARY;
+    const std::string mask_hi("\xff\x00", 2), mask_lo("\x00\xff", 2);
+    push_entry(&entries,
+	       MatchKeyParam(ternary, std::string("\xaa\x00", 2), mask_hi),
+	       &action_fn, ActionData(), 10);
+    push_entry(&entries, MatchKeyParam(ternary, "\xaa\xbb", "\xff\xff"),
+	       &action_fn, ActionData(), 2);
+    // same as the first one once masked
+    push_entry(&entries, MatchKeyParam(ternary, "\xaa\xcc", mask_hi),
+	       &action_fn, ActionData(), 10);
+    push_entry(&entries,
+	       MatchKeyParam(ternary, std::string("\x00\xbb", 2), mask_lo),
+	       &action_fn, ActionData(), 1);
+
+    std::vector<MatchErrorCode> rcs;
+    std::vector<entry_handle_t> handles;
+    table->add_entries(std::move(entries), &rcs, &handles);
+    ASSERT_EQ(4u, rcs.size());
+    ASSERT_EQ(MatchErrorCode::SUCCESS, rcs[0]);
+    ASSERT_EQ(MatchErrorCode::SUCCESS, rcs[1]);
+    ASSERT_EQ(MatchErrorCode::DUPLICATE_ENTRY, rcs[2]);
+    ASSERT_EQ(MatchErrorCode::SUCCESS, rcs[3]);
+    ASSERT_EQ(3u, table->get_num_entries());
+
+    Packet pkt(0, 0, 0, 64, PacketBuffer(128));
+    pkt.get_phv()->get_header(testHeader1).mark_valid();
+    Field &f = pkt.get_phv()->get_field(testHeader1, 0);
+    bool hit;
+    entry_handle_t handle;
+
+    f.set("0xaabb");
+    table->lookup(pkt, &hit, &handle);
+    ASSERT_TRUE(hit);
+    ASSERT_EQ(handles[3], handle);
+
+    f.set("0xaa11");
+    table->lookup(pkt, &hit, &handle);
+    ASSERT_TRUE(hit);
+    ASSERT_EQ(handles[0], handle);
+
+    f.set("0x11aa");
+    table->lookup(pkt, &hit, &handle);
+    ASSERT_FALSE(hit);
+
+    // duplicates are still detected after a deletion
+    ASSERT_EQ(MatchErrorCode::SUCCESS, table->delete_entry(handles[3]));
+    f.set("0xaabb");
+    table->lookup(pkt, &hit, &handle);
+    ASSERT_TRUE(hit);
+    ASSERT_EQ(handles[1], handle);
+    std::vector<MatchKeyParam> match_key;
+    match_key.emplace_back(MatchKeyParam::Type::TERNARY,
+			   std::string("\xaa\xbb"), std::string("\xff\xff"));
+    ASSERT_EQ(MatchErrorCode::DUPLICATE_ENTRY,
+	      table->add_entry(match_key, &action_fn, ActionData(), &handle, 2));
+    ASSERT_EQ(MatchErrorCode::SUCCESS,
+	      table->add_entry(match_key, &action_fn, ActionData(), &handle, 3));
+  }
+
+  Packet::unset_phv_factory();
+}
+
+TEST(TableBulkAdd, LPM) {
+  PHVFactory phv_factory;
+  HeaderType testHeaderType("test_t", 0);
+  testHeaderType.push_back_field("f48", 48);
+  const header_id_t testHeader1 = 0;
+  phv_factory.push_back_header("test1", testHeader1, testHeaderType);
+  Packet::set_phv_factory(phv_factory);
+
+  MatchKeyBuilder key_builder;
+  key_builder.push_back_field(testHeader1, 0, 48);
+  ActionFn action_fn("actionA", 0);
+
+  for(const char *algo : {"trie", "poptrie"}) {
+    std::unique_ptr<MatchTable> table = MatchTable::create(
+      "lpm", algo, "test_table", 0, 16, key_builder, false, false
+    );
+    table->set_next_node(0, nullptr);
+
+    std::vector<MatchTable::NewEntry> entries;
+    const MatchKeyParam::Type lpm = MatchKeyParam::Type::LPM;
+    const std::string net_8("\x0a\x00\x00\x00\x00\x00", 6);
+    const std::string net_24("\x0a\x0b\x0c\x00\x00\x00", 6);
+    const std::string net_8_unmasked("\x0a\xff\x00\x00\x00\x00", 6);
+    push_entry(&entries, MatchKeyParam(lpm, net_8, 8),
+	       &action_fn, ActionData(), 0);
+    push_entry(&entries, MatchKeyParam(lpm, net_24, 24),
+	       &action_fn, ActionData(), 0);
+    // same as the first one once masked
+    push_entry(&entries, MatchKeyParam(lpm, net_8_unmasked, 8),
+	       &action_fn, ActionData(), 0);
+    push_entry(&entries, MatchKeyParam(lpm, "\x0a\x0b\x0c\x0d\x0e\x0f", 44),
+	       &action_fn, ActionData(), 0);
+
+    std::vector<MatchErrorCode> rcs;
+    std::vector<entry_handle_t> handles;
+    table->add_entries(std::move(entries), &rcs, &handles);
+    ASSERT_EQ(4u, rcs.size());
+    ASSERT_EQ(MatchErrorCode::SUCCESS, rcs[0]);
+    ASSERT_EQ(MatchErrorCode::SUCCESS, rcs[1]);
+    ASSERT_EQ(MatchErrorCode::DUPLICATE_ENTRY, rcs[2]);
+    ASSERT_EQ(MatchErrorCode::SUCCESS, rcs[3]);
+    ASSERT_EQ(3u, table->get_num_entries());
+
+    Packet pkt(0, 0, 0, 64, PacketBuffer(128));
+    pkt.get_phv()->get_header(testHeader1).mark_valid();
+    Field &f = pkt.get_phv()->get_field(testHeader1, 0);
+    bool hit;
+    entry_handle_t handle;
+
+    f.set("0x0a0b0c0d0e01");
+    table->lookup(pkt, &hit, &handle);
+    ASSERT_TRUE(hit);
+    ASSERT_EQ(handles[3], handle);
+
+    f.set("0x0a0b0c000000");
+    table->lookup(pkt, &hit, &handle);
+    ASSERT_TRUE(hit);
+    ASSERT_EQ(handles[1], handle);
+
+    f.set("0x0a0000000000");
+    table->lookup(pkt, &hit, &handle);
+    ASSERT_TRUE(hit);
+    ASSERT_EQ(handles[0], handle);
+
+    f.set("0x0b0b0c0d0e0f");
+    table->lookup(pkt, &hit, &handle);
+    ASSERT_FALSE(hit);
+
+    ASSERT_EQ(MatchErrorCode::SUCCESS, table->delete_entry(handles[3]));
+    f.set("0x0a0b0c0d0e01");
+    table->lookup(pkt, &hit, &handle);
+    ASSERT_TRUE(hit);
+    ASSERT_EQ(handles[1], handle);
+  }
+
+  Packet::unset_phv_factory();
+}
@@ -0,0 +1,200 @@
+/* Copyright 2013-present Barefoot Networks, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Antonin Bas (antonin@barefootnetworks.com)
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+#include <map>
+#include <random>
+
+#include "bm_sim/ternary_classifier.h"
+
+typedef TernaryClassifier::handle_t handle_t;
+
+namespace {
+
+struct Rule {
+  ByteContainer key;
+  ByteContainer mask;
+  int priority;
+};
+
+}  // namespace
+
+// compares the classifier with a scan of all the rules in handle order
+class TernaryClassifierTest : public ::testing::TestWithParam<std::string> {
+protected:
+  static const size_t nbytes_key = 6;
+
+  std::unique_ptr<TernaryClassifier> classifier;
+  std::map<handle_t, Rule> rules{};
+  std::mt19937 gen{0};
+
+  TernaryClassifierTest()
+    : classifier(TernaryClassifier::create(GetParam(), nbytes_key)) { }
+
+  ByteContainer random_bytes() {
+    std::uniform_int_distribution<int> dis(0, 255);
+    ByteContainer bytes;
+    for(size_t i = 0; i < nbytes_key; i++) bytes.push_back(dis(gen));
+    return bytes;
+  }
+
+  // a few distinct masks, like in a real ACL
+  ByteContainer random_mask() {
+    static const char *masks[] = {
+      "0xffffffffffff", "0xffffff000000", "0xff00ff00ff00", "0x000000ffff00",
+      "0xfff000000000", "0x000000000000", "0x0f0f0f0f0f0f"
+    };
+    std::uniform_int_distribution<size_t> dis(0, 6);
+    return ByteContainer(masks[dis(gen)]);
+  }
+
+  void insert(handle_t handle, ByteContainer key, ByteContainer mask,
+	      int priority) {
+    for(size_t i = 0; i < nbytes_key; i++) key[i] &= mask[i];
+    classifier->insert(handle, key, mask, priority);
+    rules[handle] = {key, mask, priority};
+  }
+
+  void remove(handle_t handle) {
+    const Rule &rule = rules[handle];
+    classifier->remove(handle, rule.key, rule.mask, rule.priority);
+    rules.erase(handle);
+  }
+
+  bool reference_lookup(const ByteContainer &key, handle_t *handle) const {
+    const Rule *best = nullptr;
+    for(const auto &p : rules) {
+      const Rule &rule = p.second;
+      if(best && rule.priority >= best->priority) continue;
+      bool match = true;
+      for(size_t i = 0; i < nbytes_key; i++) {
+	if((key[i] & rule.mask[i]) != rule.key[i]) match = false;
+      }
+      if(match) {
+	best = &rule;
+	*handle = p.first;
+      }
+    }
+    return best != nullptr;
+  }
+
+  void check_lookup(const ByteContainer &key) {
+    handle_t expected = 0, actual = 0;
+    bool hit = reference_lookup(key, &expected);
+    ASSERT_EQ(hit, classifier->lookup(key, &actual));
+    if(hit) {
+      ASSERT_EQ(expected, actual);
+    }
+  }
+
+  // keys close to the ones of the rules, so that lookups hit
+  ByteContainer random_lookup_key() {
+    std::uniform_int_distribution<size_t> dis(0, rules.size());
+    size_t idx = dis(gen);
+    ByteContainer key = random_bytes();
+    if(idx == rules.size()) return key;
+    auto it = rules.begin();
+    std::advance(it, idx);
+    for(size_t i = 0; i < nbytes_key; i++)
+      key[i] = it->second.key[i] | (key[i] & ~it->second.mask[i]);
+    return key;
+  }
+};
+
+TEST_P(TernaryClassifierTest, Empty) {
+  ASSERT_NE(nullptr, classifier);
+  handle_t handle;
+  ASSERT_FALSE(classifier->lookup(random_bytes(), &handle));
+}
+
+TEST_P(TernaryClassifierTest, Priority) {
+  const ByteContainer key("0x0a0b0c0d0e0f");
+  insert(3, key, ByteContainer("0xffffffffffff"), 10);
+  insert(4, key, ByteContainer("0xffff00000000"), 5);
+  handle_t handle;
+  ASSERT_TRUE(classifier->lookup(key, &handle));
+  ASSERT_EQ(4u, handle);
+
+  // same priority, the lowest handle wins
+  insert(1, key, ByteContainer("0xff0000000000"), 5);
+  ASSERT_TRUE(classifier->lookup(key, &handle));
+  ASSERT_EQ(1u, handle);
+
+  // same masked key and mask, different priority
+  insert(7, key, ByteContainer("0xff0000000000"), 2);
+  ASSERT_TRUE(classifier->lookup(key, &handle));
+  ASSERT_EQ(7u, handle);
+
+  remove(7);
+  remove(1);
+  ASSERT_TRUE(classifier->lookup(key, &handle));
+  ASSERT_EQ(4u, handle);
+  remove(4);
+  ASSERT_TRUE(classifier->lookup(key, &handle));
+  ASSERT_EQ(3u, handle);
+  ASSERT_FALSE(classifier->lookup(ByteContainer("0x0a0b0c0d0e00"), &handle));
+  remove(3);
+  ASSERT_FALSE(classifier->lookup(key, &handle));
+}
+
+TEST_P(TernaryClassifierTest, Random) {
+  std::uniform_int_distribution<int> priority_dis(0, 50);
+  std::uniform_int_distribution<int> op_dis(0, 2);
+  handle_t next_handle = 0;
+  for(int i = 0; i < 3000; i++) {
+    if(op_dis(gen) == 0 && !rules.empty()) {
+      std::uniform_int_distribution<size_t> dis(0, rules.size() - 1);
+      auto it = rules.begin();
+      std::advance(it, dis(gen));
+      remove(it->first);
+    }
+    else {
+      insert(next_handle++, random_bytes(), random_mask(), priority_dis(gen));
+    }
+    check_lookup(random_lookup_key());
+    check_lookup(random_bytes());
+  }
+  for(int i = 0; i < 1000; i++) check_lookup(random_lookup_key());
+
+  classifier->clear();
+  rules.clear();
+  check_lookup(random_bytes());
+}
+
+// the rules inserted in a batch can only be looked up once it is over
+TEST_P(TernaryClassifierTest, Batch) {
+  std::uniform_int_distribution<int> priority_dis(0, 20);
+  handle_t next_handle = 0;
+  for(int batch = 0; batch < 3; batch++) {
+    classifier->begin_batch();
+    for(int i = 0; i < 500; i++)
+      insert(next_handle++, random_bytes(), random_mask(), priority_dis(gen));
+    classifier->end_batch();
+    for(int i = 0; i < 500; i++) check_lookup(random_lookup_key());
+  }
+  while(rules.size() > 100) remove(rules.begin()->first);
+  for(int i = 0; i < 500; i++) check_lookup(random_lookup_key());
+}
+
+INSTANTIATE_TEST_CASE_P(TernaryClassifierAlgos, TernaryClassifierTest,
+			::testing::Values("tuple_space", "packed_scan"));
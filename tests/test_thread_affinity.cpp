@@ -0,0 +1,55 @@
+/* Copyright 2013-present Barefoot Networks, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Antonin Bas (antonin@barefootnetworks.com)
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include <vector>
+#include <string>
+
+#include "bm_sim/thread_affinity.h"
+
+TEST(ThreadAffinity, ParseCpuList) {
+  std::vector<int> cpus;
+  ASSERT_TRUE(ThreadAffinity::parse_cpu_list("3", &cpus));
+  ASSERT_EQ(std::vector<int>({3}), cpus);
+  ASSERT_TRUE(ThreadAffinity::parse_cpu_list("0-3,8,10-11", &cpus));
+  ASSERT_EQ(std::vector<int>({0, 1, 2, 3, 8, 10, 11}), cpus);
+}
+
+TEST(ThreadAffinity, ParseInvalidCpuList) {
+  std::vector<int> cpus;
+  for(const char *str : {"", "a", "1,", "1,,2", "3-1", "-1", "1-",
+	"1-2x", "2x", "0-100000"}) {
+    ASSERT_FALSE(ThreadAffinity::parse_cpu_list(str, &cpus)) << str;
+  }
+}
+
+TEST(ThreadAffinity, RunPinned) {
+  int value = 0;
+  // no CPUs for the role, runs on the calling thread
+  ThreadAffinity::run_pinned(ThreadAffinity::Role::EGRESS, 0,
+			     [&value]() { value = 1; });
+  ASSERT_EQ(1, value);
+  ThreadAffinity::set_cpus(ThreadAffinity::Role::EGRESS, {0});
+  ThreadAffinity::run_pinned(ThreadAffinity::Role::EGRESS, 3,
+			     [&value]() { value = 2; });
+  ASSERT_EQ(2, value);
+  ThreadAffinity::set_cpus(ThreadAffinity::Role::EGRESS, {});
+}
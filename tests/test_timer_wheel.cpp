@@ -0,0 +1,133 @@
+/* Copyright 2013-present Barefoot Networks, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Antonin Bas (antonin@barefootnetworks.com)
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <vector>
+#include <random>
+#include <algorithm>
+
+#include "bm_sim/timer_wheel.h"
+
+typedef TimerWheel<int>::clock Clock;
+using std::chrono::microseconds;
+
+class TimerWheelTest : public ::testing::Test {
+protected:
+  Clock::time_point origin{};
+  TimerWheel<int> wheel;
+
+  TimerWheelTest()
+    : wheel(microseconds(1), origin) { }
+
+  Clock::time_point at(int64_t us) const {
+    return origin + microseconds(us);
+  }
+
+  std::vector<int> advance(int64_t us) {
+    std::vector<int> fired;
+    wheel.advance(at(us), [&fired](int item) { fired.push_back(item); });
+    return fired;
+  }
+};
+
+TEST_F(TimerWheelTest, Empty) {
+  ASSERT_TRUE(wheel.empty());
+  ASSERT_EQ(Clock::time_point::max(), wheel.next_expiry());
+  ASSERT_TRUE(advance(1000000).empty());
+}
+
+TEST_F(TimerWheelTest, FireInOrder) {
+  wheel.schedule(at(300), 3);
+  wheel.schedule(at(10), 1);
+  wheel.schedule(at(70000), 4);
+  wheel.schedule(at(100), 2);
+  ASSERT_EQ(4u, wheel.size());
+  ASSERT_EQ(at(10), wheel.next_expiry());
+
+  ASSERT_TRUE(advance(9).empty());
+  ASSERT_EQ(std::vector<int>({1}), advance(10));
+  ASSERT_EQ(at(100), wheel.next_expiry());
+  ASSERT_EQ(std::vector<int>({2}), advance(299));
+  // in level 1, the expiry is only known to the nearest 256 ticks
+  ASSERT_GE(at(300), wheel.next_expiry());
+  ASSERT_EQ(std::vector<int>({3}), advance(69999));
+  ASSERT_EQ(std::vector<int>({4}), advance(70000));
+  ASSERT_TRUE(wheel.empty());
+}
+
+TEST_F(TimerWheelTest, PastAndRoundedUp) {
+  advance(50);
+  wheel.schedule(at(20), 1);
+  ASSERT_EQ(at(50), wheel.next_expiry());
+  // expiries are rounded up to the next tick
+  wheel.schedule(at(60) + std::chrono::nanoseconds(1), 2);
+  ASSERT_EQ(std::vector<int>({1}), advance(60));
+  ASSERT_EQ(std::vector<int>({2}), advance(61));
+}
+
+TEST_F(TimerWheelTest, Overflow) {
+  const int64_t far = (int64_t(1) << 32) + 12345;
+  wheel.schedule(at(far), 1);
+  ASSERT_TRUE(advance(far - 1).empty());
+  ASSERT_EQ(std::vector<int>({1}), advance(far));
+}
+
+TEST_F(TimerWheelTest, ScheduleFromFire) {
+  wheel.schedule(at(5), 0);
+  int64_t now = 0;
+  for(int i = 1; i < 10; i++) {
+    now += 1000;
+    std::vector<int> fired;
+    wheel.advance(at(now), [this, now, &fired](int item) {
+	fired.push_back(item);
+	wheel.schedule(at(now + 5), item + 1);
+      });
+    ASSERT_EQ(std::vector<int>({i - 1}), fired);
+  }
+}
+
+TEST_F(TimerWheelTest, Random) {
+  std::mt19937 gen(42);
+  std::uniform_int_distribution<int64_t> dis(0, 20000000);
+  std::vector<int64_t> expiries;
+  for(int i = 0; i < 10000; i++) {
+    expiries.push_back(dis(gen));
+    wheel.schedule(at(expiries.back()), i);
+  }
+  std::vector<int> order(expiries.size());
+  for(size_t i = 0; i < order.size(); i++) order[i] = i;
+  std::stable_sort(order.begin(), order.end(), [&expiries](int a, int b) {
+      return expiries[a] < expiries[b];
+    });
+
+  size_t fired = 0;
+  int64_t now = 0;
+  while(fired < order.size()) {
+    now += 997;
+    wheel.advance(at(now), [&](int item) {
+	ASSERT_LE(expiries[item], now);
+	ASSERT_GT(expiries[item], now - 997);
+	fired++;
+      });
+  }
+  ASSERT_TRUE(wheel.empty());
+}
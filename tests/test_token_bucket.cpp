@@ -0,0 +1,126 @@
+/* Copyright 2013-present Barefoot Networks, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Antonin Bas (antonin@barefootnetworks.com)
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+
+#include "bm_sim/token_bucket.h"
+
+typedef TokenBucket::clock Clock;
+using std::chrono::microseconds;
+using std::chrono::milliseconds;
+
+static Clock::time_point at_us(int64_t us) {
+  return Clock::time_point() + microseconds(us);
+}
+
+TEST(TokenBucket, Disabled) {
+  TokenBucket bucket;
+  ASSERT_FALSE(bucket.is_enabled());
+  bucket.consume(at_us(0), 1000000);
+  ASSERT_TRUE(bucket.ready(at_us(0)));
+}
+
+TEST(TokenBucket, PacketRate) {
+  TokenBucket bucket;
+  bucket.set_rate(1000, 1);  // one packet every ms
+  ASSERT_TRUE(bucket.ready(at_us(0)));
+  bucket.consume(at_us(0), 1);
+  ASSERT_FALSE(bucket.ready(at_us(999)));
+  ASSERT_EQ(at_us(1000), bucket.next_departure());
+  ASSERT_TRUE(bucket.ready(at_us(1000)));
+}
+
+TEST(TokenBucket, Burst) {
+  TokenBucket bucket;
+  bucket.set_rate(1000, 4);
+  // the bucket starts full
+  for(int i = 0; i < 4; i++) {
+    ASSERT_TRUE(bucket.ready(at_us(0)));
+    bucket.consume(at_us(0), 1);
+  }
+  ASSERT_FALSE(bucket.ready(at_us(0)));
+  ASSERT_TRUE(bucket.ready(at_us(1000)));
+  // after a long idle period, the bucket holds no more than the burst
+  const auto later = at_us(1000000);
+  for(int i = 0; i < 4; i++) {
+    ASSERT_TRUE(bucket.ready(later));
+    bucket.consume(later, 1);
+  }
+  ASSERT_FALSE(bucket.ready(later));
+}
+
+TEST(TokenBucket, ByteRateDebt) {
+  TokenBucket bucket;
+  bucket.set_rate(1000000, 1500);  // 1 byte per us
+  bucket.consume(at_us(0), 1500);
+  // one byte is enough to send a packet, and then we are in debt
+  ASSERT_TRUE(bucket.ready(at_us(1)));
+  bucket.consume(at_us(1), 3000);
+  ASSERT_FALSE(bucket.ready(at_us(3000)));
+  ASSERT_TRUE(bucket.ready(at_us(3001)));
+}
+
+TEST(TokenBucket, RateChange) {
+  TokenBucket bucket;
+  bucket.set_rate(1, 1, at_us(0));  // one packet every second
+  for(int i = 0; i < 10; i++) bucket.consume(at_us(0), 1);
+  ASSERT_FALSE(bucket.ready(at_us(1000)));
+  // the debt made at 1 pps does not delay the packets sent at 1 Mpps
+  bucket.set_rate(1000000, 1, at_us(1000));
+  ASSERT_TRUE(bucket.ready(at_us(1000)));
+  bucket.consume(at_us(1000), 1);
+  ASSERT_EQ(at_us(1001), bucket.next_departure());
+  // a lower rate applies from the next packet
+  bucket.set_rate(1000, 1, at_us(1000));
+  ASSERT_TRUE(bucket.ready(at_us(1000)));
+  bucket.consume(at_us(1000), 1);
+  ASSERT_FALSE(bucket.ready(at_us(1999)));
+  ASSERT_TRUE(bucket.ready(at_us(2000)));
+}
+
+TEST(TokenBucket, NoDrift) {
+  TokenBucket bucket;
+  bucket.set_rate(3, 1);  // a third of a second per packet
+  Clock::time_point t = at_us(0);
+  for(int i = 0; i < 3000; i++) {
+    t = std::max(t, bucket.next_departure());
+    bucket.consume(t, 1);
+  }
+  auto elapsed = bucket.next_departure() - at_us(0);
+  ASSERT_NEAR(1000., std::chrono::duration<double>(elapsed).count(), 1e-6);
+}
+
+TEST(Shaper, BothRates) {
+  Shaper shaper;
+  ASSERT_FALSE(shaper.is_enabled());
+  shaper.set_packet_rate(1000);  // one packet every ms
+  shaper.set_byte_rate(1000000, 1);  // 1 byte per us
+  ASSERT_TRUE(shaper.is_enabled());
+  shaper.consume(at_us(0), 100);
+  // the packet rate is the limit
+  ASSERT_EQ(at_us(1000), shaper.next_departure());
+  shaper.consume(at_us(1000), 5000);
+  // the byte rate is the limit
+  ASSERT_EQ(at_us(6000), shaper.next_departure());
+  shaper.set_byte_rate(0, 0);
+  ASSERT_EQ(at_us(2000), shaper.next_departure());
+}
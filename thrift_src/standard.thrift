@@ -71,6 +71,25 @@ struct BmAddEntryOptions {
   1:optional i32 priority
 }
 
+struct BmNewEntry {
+  1:BmMatchParams match_key,
+  2:string action_name,
+  3:BmActionData action_data,
+  4:BmAddEntryOptions options
+}
+
+struct BmIndirectNewEntry {
+  1:BmMatchParams match_key,
+  2:BmMemberHandle mbr_handle,
+  3:BmAddEntryOptions options
+}
+
+struct BmIndirectWsNewEntry {
+  1:BmMatchParams match_key,
+  2:BmGroupHandle grp_handle,
+  3:BmAddEntryOptions options
+}
+
 struct BmCounterValue {
   1:i64 bytes;
   2:i64 packets;
@@ -105,6 +124,12 @@ exception InvalidTableOperation {
   1:TableOperationErrorCode what
 }
 
+# error is only set if the entry could not be added
+struct BmAddEntryResult {
+  1:BmEntryHandle entry_handle,
+  2:optional TableOperationErrorCode error
+}
+
 enum CounterOperationErrorCode {
   INVALID_COUNTER_NAME = 1,
   INVALID_INDEX = 2,
@@ -158,6 +183,12 @@ service Standard {
     5:BmAddEntryOptions options
   ) throws (1:InvalidTableOperation ouch),
 
+  // one result per entry, all the entries are added under a single lock
+  list<BmAddEntryResult> bm_mt_add_entries(
+    1:string table_name,
+    2:list<BmNewEntry> entries
+  ) throws (1:InvalidTableOperation ouch),
+
   void bm_mt_set_default_action(
     1:string table_name,
     2:string action_name,
@@ -209,6 +240,11 @@ service Standard {
     4:BmAddEntryOptions options
   ) throws (1:InvalidTableOperation ouch),
 
+  list<BmAddEntryResult> bm_mt_indirect_add_entries(
+    1:string table_name,
+    2:list<BmIndirectNewEntry> entries
+  ) throws (1:InvalidTableOperation ouch),
+
   void bm_mt_indirect_modify_entry(
     1:string table_name,
     2:BmEntryHandle entry_handle,
@@ -261,6 +297,11 @@ service Standard {
     4:BmAddEntryOptions options
   ) throws (1:InvalidTableOperation ouch),
 
+  list<BmAddEntryResult> bm_mt_indirect_ws_add_entries(
+    1:string table_name,
+    2:list<BmIndirectWsNewEntry> entries
+  ) throws (1:InvalidTableOperation ouch),
+
   void bm_mt_indirect_ws_modify_entry(
     1:string table_name,
     2:BmEntryHandle entry_handle,
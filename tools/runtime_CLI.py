@@ -468,17 +468,16 @@ class RuntimeAPI(cmd.Cmd):
     def complete_table_set_default(self, text, line, start_index, end_index):
         return self._complete_table_and_action(text, line)
 
-    def do_table_add(self, line):
-        "Add entry to a match table: table_add <table name> <action name> <match fields> => <action parameters> [priority]"
-        args = line.split()
+    # returns None (after printing the error) if the entry is not valid
+    def _parse_table_add(self, args):
         table_name, action_name = args[0], args[1]
         if table_name not in TABLES:
             print "Invalid table"
-            return
+            return None
         table = TABLES[table_name]
         if action_name not in table.actions:
             print "Invalid action"
-            return
+            return None
         if table.match_type == MatchType.TERNARY:
             priority = int(args.pop(-1))
         else:
@@ -491,20 +490,28 @@ class RuntimeAPI(cmd.Cmd):
         action_params = args[idx+1:]
         if len(match_key) != table.num_key_fields():
             print "Table", table_name, "needs", table.num_key_fields(), "key fields"
-            return
+            return None
         if len(action_params) != action.num_params():
             print "Action", action_name, "needs", action.num_params(), "parameters"
-            return
+            return None
 
         try:
             runtime_data = parse_runtime_data(action, action_params)
         except:
             print "Invalid parameter"
-            return
-
-        print "Adding entry to", MatchType.to_str(table.match_type), "match table", table_name
+            return None
 
         match_key = parse_match_key(table, match_key)
+        return table, action_name, match_key, runtime_data, priority
+
+    def do_table_add(self, line):
+        "Add entry to a match table: table_add <table name> <action name> <match fields> => <action parameters> [priority]"
+        parsed = self._parse_table_add(line.split())
+        if parsed is None:
+            return
+        table, action_name, match_key, runtime_data, priority = parsed
+
+        print "Adding entry to", MatchType.to_str(table.match_type), "match table", table.name
 
         print "{0:20} {1}".format(
             "match key:",
@@ -517,7 +524,7 @@ class RuntimeAPI(cmd.Cmd):
         )
 
         entry_handle = self.client.bm_mt_add_entry(
-            table_name, match_key, action_name, runtime_data,
+            table.name, match_key, action_name, runtime_data,
             BmAddEntryOptions(priority = priority)
         )
         print "SUCCESS"
@@ -526,6 +533,45 @@ class RuntimeAPI(cmd.Cmd):
     def complete_table_add(self, text, line, start_index, end_index):
         return self._complete_table_and_action(text, line)
 
+    def do_table_add_file(self, line):
+        "Add the entries listed in a file, one per line with the same syntax as table_add, consecutive entries of a table being added at once: table_add_file <path to file>"
+        filename = line
+        if not os.path.isfile(filename):
+            print filename, "is not a valid file"
+            return
+        batches = []
+        with open(filename, 'r') as f:
+            for line_no, entry_line in enumerate(f, 1):
+                args = entry_line.split()
+                if not args or args[0].startswith("#"):
+                    continue
+                parsed = self._parse_table_add(args)
+                if parsed is None:
+                    print "Error on line", line_no
+                    return
+                table, action_name, match_key, runtime_data, priority = parsed
+                entry = BmNewEntry(match_key, action_name, runtime_data,
+                                   BmAddEntryOptions(priority = priority))
+                if batches and batches[-1][0] == table.name:
+                    batches[-1][1].append(entry)
+                    batches[-1][2].append(line_no)
+                else:
+                    batches.append((table.name, [entry], [line_no]))
+
+        total_errors = 0
+        for table_name, entries, line_nos in batches:
+            print "Adding", len(entries), "entries to", table_name
+            results = self.client.bm_mt_add_entries(table_name, entries)
+            nb_errors = 0
+            for line_no, result in zip(line_nos, results):
+                if result.error is not None:
+                    print "Entry on line", line_no, "could not be added:", table_error_name(result.error)
+                    nb_errors += 1
+            print len(results) - nb_errors, "entries have been added"
+            total_errors += nb_errors
+        if total_errors == 0:
+            print "SUCCESS"
+
     def do_table_delete(self, line):
         "Delete entry from a match table: table_delete <table name> <entry handle>"
         args = line.split()